@@ -19,22 +19,193 @@ namespace loco {
          */
         static constexpr QLength LINE_SENSOR_DISTANCE_THRESHOLD = 1_in;
 
+        /**
+         * @brief Spread of the raw line sensor values around LINE_SENSOR_THRESHOLD used by LineMapSensorModel. Values this
+         * far below the threshold are 73% likely to be tape, values twice as far 88%.
+         */
+        static constexpr float LINE_SENSOR_SOFTNESS = 300.0;
+
+        /**
+         * @brief Width of the blurred edge of the tape in a LineMap, covering the size of the sensor's spot and the
+         * quantization of the map.
+         */
+        static constexpr QLength LINE_EDGE_SOFTNESS = 0.5_cm;
+
+        /**
+         * @brief Likelihood LineMapSensorModel gives a particle whose prediction completely disagrees with the sensor,
+         * relative to one that agrees. Keeps a single bad reading from wiping out the particles.
+         */
+        static constexpr float LINE_MIN_LIKELIHOOD = 0.4;
+
         /**
          * @brief Weight for the distance sensor. Higher means it will have a larger impact on the particle filter, lower
          * means a smaller impact.
          */
         static constexpr float DISTANCE_WEIGHT = 1.0;
 
+        /**
+         * @brief Share of distance sensor readings that hit the predicted wall or field element, with Gaussian noise.
+         * The four DISTANCE_Z_ values make up the beam mixture of DistanceSensorModel and should add up to 1.
+         */
+        static constexpr float DISTANCE_Z_HIT = 0.75;
+
+        /**
+         * @brief Share of distance sensor readings that are short because something unmapped, such as another robot or a
+         * game object, is in front of the wall.
+         */
+        static constexpr float DISTANCE_Z_SHORT = 0.1;
+
+        /**
+         * @brief Share of distance sensor readings that return no object even though a wall is in range.
+         */
+        static constexpr float DISTANCE_Z_MAX = 0.05;
+
+        /**
+         * @brief Share of distance sensor readings that are random anywhere in the sensor's range.
+         */
+        static constexpr float DISTANCE_Z_RAND = 0.1;
+
+        /**
+         * @brief Rate of the exponential distribution of short readings, in 1/m. Higher values expect unmapped objects
+         * closer to the sensor.
+         */
+        static constexpr float DISTANCE_LAMBDA_SHORT = 1.5;
+
+        /**
+         * @brief Maximum range of the distance sensor, farther objects read as no object.
+         */
+        static constexpr QLength DISTANCE_MAX_RANGE = 2_m;
+
+        /**
+         * @brief Number of intervals in the per-update table of the beam mixture, spread over ±8 standard deviations
+         * of the hit noise.
+         */
+        static constexpr size_t DISTANCE_MIXTURE_TABLE_SIZE = 64;
+
         /**
          * @brief Weight for the game positioning sensor. Higher means it will have a larger impact on the particle filter, lower
          * means a smaller impact.
          */
         static constexpr float GPS_WEIGHT = 1.0;
 
+        /**
+         * @brief Standard deviation of the GPS position as a multiple of the error reported by the sensor.
+         */
+        static constexpr float GPS_ERROR_SCALE = 8.0;
+
+        /**
+         * @brief Smallest standard deviation used for the GPS position, so a reported error of 0 doesn't make the
+         * likelihood infinitely sharp.
+         */
+        static constexpr QLength GPS_MIN_STD = 1_cm;
+
+        /**
+         * @brief Standard deviation of the yaw reported by the GPS, used by HeadingEstimator to weigh it against the
+         * IMU.
+         */
+        static constexpr Angle GPS_HEADING_STD = 2_deg;
+
+        /**
+         * @brief Standard deviation of the IMU's drift over a single update of HeadingEstimator. Higher values trust the
+         * GPS yaw more and correct the drift faster, at the cost of a noisier heading.
+         */
+        static constexpr Angle HEADING_DRIFT = 0.005_deg;
+
+        /**
+         * @brief Default for the largest change in a particle's heading per frame in filters with per-particle
+         * headings, on top of the rotation of the robot. Lets the particles follow IMU drift and bumps, higher values
+         * follow bumps faster but spread the particles over more headings.
+         */
+        static constexpr Angle PARTICLE_HEADING_NOISE = 0.5_deg;
+
         /**
          * @brief Weight for the line sensor. Higher means it will have a larger impact on the particle filter, lower
          * means a smaller impact.
          */
         static constexpr float LINE_WEIGHT = 1.0;
+
+        /**
+         * @brief Most updates in a row a sensor without a sequence number, like the distance sensor or GPS, reports an
+         * identical reading as the previous sample read again. After that the reading counts as a new sample, so a
+         * robot standing still or driving parallel to a wall keeps correcting. Should be longer than the sensors'
+         * refresh period in updates.
+         */
+        static constexpr size_t SENSOR_MAX_STALE_FRAMES = 5;
+
+        /**
+         * @brief Default effective sample size, as a fraction of the particle count, below which the particle filter
+         * resamples. Higher values resample more often.
+         */
+        static constexpr double RESAMPLE_THRESHOLD = 0.5;
+
+        /**
+         * @brief Length of each particle's Metropolis chain in MetropolisResampler. Longer chains reduce the bias of
+         * the resampler when the weights are very uneven.
+         */
+        static constexpr size_t METROPOLIS_ITERATIONS = 20;
+
+        /**
+         * @brief Size of the square bins used by KLD-sampling to measure how spread out the particles are. Smaller bins
+         * keep more particles alive once the filter has converged.
+         */
+        static constexpr QLength KLD_BIN_SIZE = 3_in;
+
+        /**
+         * @brief Maximum KL-divergence between the particle approximation and the true belief for KLD-sampling. Lower
+         * values use more particles.
+         */
+        static constexpr float KLD_EPSILON = 0.1;
+
+        /**
+         * @brief Upper standard normal quantile for KLD-sampling, 2.326 is the quantile for a 99% chance that the error
+         * stays below KLD_EPSILON.
+         */
+        static constexpr float KLD_Z = 2.326;
+
+        /**
+         * @brief Minimum number of particles kept by KLD-sampling, regardless of how concentrated the belief is.
+         */
+        static constexpr size_t KLD_MIN_PARTICLES = 20;
+
+        /**
+         * @brief Smoothing factor for the long term average particle weight, used to detect kidnapping. Must be much
+         * smaller than RECOVERY_ALPHA_FAST.
+         */
+        static constexpr float RECOVERY_ALPHA_SLOW = 0.02;
+
+        /**
+         * @brief Smoothing factor for the short term average particle weight, used to detect kidnapping.
+         */
+        static constexpr float RECOVERY_ALPHA_FAST = 0.2;
+
+        /**
+         * @brief When the short term average particle weight drops below this fraction of the long term average, the
+         * filter is assumed to be lost and random particles are injected.
+         */
+        static constexpr float RECOVERY_WEIGHT_RATIO = 0.5;
+
+        /**
+         * @brief Time a particle filter update is expected to fit in, updates taking longer are counted as overruns by
+         * FrameProfiler. Matches the 10ms period of the V5 sensors.
+         */
+        static constexpr QTime FRAME_BUDGET = 10_ms;
+
+        /**
+         * @brief Smoothing factor for the per particle cost of each part of the update, used to plan updates with a
+         * time budget. Higher values follow changes in the cost faster, lower values ignore single slow frames.
+         */
+        static constexpr float DEADLINE_COST_SMOOTHING = 0.2;
+
+        /**
+         * @brief Fewest particles weighted by an update with a time budget before sensors are skipped instead. Fewer
+         * particles than this can't represent the belief after resampling.
+         */
+        static constexpr size_t DEADLINE_MIN_PARTICLES = 20;
+
+        /**
+         * @brief Fraction of an update's time budget kept free when planning the update, since the measured costs are
+         * averages and a single update can take longer.
+         */
+        static constexpr float DEADLINE_MARGIN = 0.1;
     };
 }
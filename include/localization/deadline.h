@@ -0,0 +1,244 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "config.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace loco {
+    /**
+     * @brief How much a particle filter update was degraded to fit in its time budget. Returned by the update overloads
+     * that take a budget, an update that fit without degrading has every particle and fresh sensor weighted and no
+     * resampling deferred.
+     */
+    struct DeadlineReport {
+        /**
+         * @brief Time the update took, in microseconds.
+         */
+        uint32_t elapsed = 0;
+
+        /**
+         * @brief Time the update was allowed to take, in microseconds.
+         */
+        uint32_t budget = 0;
+
+        /**
+         * @brief Whether the sensors were updated and the particles weighted this frame. False when the robot hasn't
+         * moved far enough since the last correction, no sensor had a new sample, or the budget ran out first.
+         */
+        bool corrected = false;
+
+        /**
+         * @brief Number of particles weighted by the sensors. When fewer than every particle are weighted, the
+         * particles are resampled from the weighted ones.
+         */
+        size_t particlesWeighted = 0;
+
+        /**
+         * @brief Number of particles in the filter.
+         */
+        size_t particleCount = 0;
+
+        /**
+         * @brief Number of sensors with a new sample that were used to weight the particles.
+         */
+        size_t sensorsWeighted = 0;
+
+        /**
+         * @brief Number of sensors with a new sample this frame, skipped sensors lose their sample.
+         */
+        size_t sensorsFresh = 0;
+
+        /**
+         * @brief Whether resampling was due but left for a later update, the weights carry over until then.
+         */
+        bool resamplingDeferred = false;
+
+        /**
+         * @brief Whether a sensor returned NaN or infinity for a particle. The weights of the frame are thrown away and
+         * every particle is reset to the same weight.
+         */
+        bool weightsInvalid = false;
+
+        /**
+         * @return Whether the update took longer than its budget
+         */
+        [[nodiscard]] bool overrun() const {
+            return elapsed > budget;
+        }
+
+        /**
+         * @return Whether the update skipped any work to fit in its budget
+         */
+        [[nodiscard]] bool degraded() const {
+            return sensorsWeighted < sensorsFresh || (corrected && particlesWeighted < particleCount) ||
+                   resamplingDeferred;
+        }
+    };
+
+    /**
+     * @brief Running estimate of the time a part of the update takes per particle, used to plan updates with a time
+     * budget. Smoothed with LOCO_CONFIG::DEADLINE_COST_SMOOTHING, so it follows changes in the particle count and in
+     * how long the sensors take without reacting to a single slow frame.
+     */
+    class CostEstimate {
+    private:
+        float perParticle = 0.0f;
+        bool measured = false;
+
+    public:
+        /**
+         * @brief Add a measurement.
+         *
+         * @param elapsed Time the work took, in microseconds
+         * @param particles Number of particles the work covered
+         */
+        void add(const uint32_t elapsed, const size_t particles) {
+            if (particles == 0) {
+                return;
+            }
+
+            const float sample = static_cast<float>(elapsed) / static_cast<float>(particles);
+
+            perParticle = measured
+                              ? perParticle + LOCO_CONFIG::DEADLINE_COST_SMOOTHING * (sample - perParticle)
+                              : sample;
+            measured = true;
+        }
+
+        /**
+         * @param particles Number of particles
+         * @return Estimated time for the particles in microseconds, 0 before the first measurement
+         */
+        [[nodiscard]] float estimate(const size_t particles) const {
+            return perParticle * static_cast<float>(particles);
+        }
+    };
+
+    /**
+     * @brief Profiler handed to the sensor sets by updates that track their cost. The likelihood time of each sensor
+     * is added up for the frame and then forwarded to the filter's own profiler.
+     *
+     * @tparam Profiler Profiler of the particle filter
+     */
+    template<typename Profiler>
+    class SensorTimer {
+    private:
+        Profiler &profiler;
+        std::vector<uint32_t> &times;
+
+    public:
+        /**
+         * @param profiler Profiler the sensor times are forwarded to
+         * @param times Time of each sensor this frame in microseconds, one per sensor
+         */
+        SensorTimer(Profiler &profiler, std::vector<uint32_t> &times)
+            : profiler(profiler),
+              times(times) {
+        }
+
+        /**
+         * @return Current time in microseconds
+         */
+        static uint32_t now() {
+            return pros::micros();
+        }
+
+        /**
+         * @brief Add time spent evaluating a sensor's likelihood to the current frame.
+         *
+         * @param sensor Index of the sensor in the sensor set
+         * @param start Time the evaluation started, from now()
+         */
+        void recordSensor(const size_t sensor, const uint32_t start) {
+            times[sensor] += now() - start;
+            profiler.recordSensor(sensor, start);
+        }
+    };
+
+    /**
+     * @brief Budget of a single update, started when the update starts. A deadline without a budget only reads the
+     * clock if it was created with measured(), so plain updates don't pay for timing they never use.
+     */
+    class Deadline {
+    private:
+        uint32_t start;
+        uint32_t budget;
+        bool timed;
+
+        Deadline(const uint32_t start, const uint32_t budget, const bool timed)
+            : start(start),
+              budget(budget),
+              timed(timed) {
+        }
+
+    public:
+        /**
+         * @brief Deadline that never expires and doesn't measure the update, for updates without a budget.
+         */
+        Deadline() : Deadline(0, std::numeric_limits<uint32_t>::max(), false) {
+        }
+
+        /**
+         * @param budget Time the update is allowed to take
+         */
+        explicit Deadline(const QTime budget)
+            : Deadline(pros::micros(), static_cast<uint32_t>(std::max(budget.Convert(millisecond) * 1000.0f, 0.0f)),
+                       true) {
+        }
+
+        /**
+         * @return Deadline that never expires but still measures the update, for updates without a budget that are
+         * profiled
+         */
+        static Deadline measured() {
+            return {static_cast<uint32_t>(pros::micros()), std::numeric_limits<uint32_t>::max(), true};
+        }
+
+        /**
+         * @return Whether the update has a budget
+         */
+        [[nodiscard]] bool limited() const {
+            return budget != std::numeric_limits<uint32_t>::max();
+        }
+
+        /**
+         * @return Whether the update is measured, elapsed() is always 0 otherwise
+         */
+        [[nodiscard]] bool isTimed() const {
+            return timed;
+        }
+
+        /**
+         * @return Time since the update started in microseconds, 0 if the update isn't measured
+         */
+        [[nodiscard]] uint32_t elapsed() const {
+            return timed ? static_cast<uint32_t>(pros::micros()) - start : 0;
+        }
+
+        /**
+         * @return Time left in the budget in microseconds, negative once it has run out
+         */
+        [[nodiscard]] float remaining() const {
+            return static_cast<float>(budget) - static_cast<float>(elapsed());
+        }
+
+        /**
+         * @return Time left in the budget in microseconds, less LOCO_CONFIG::DEADLINE_MARGIN of the budget kept free
+         * for updates that take longer than planned
+         */
+        [[nodiscard]] float plannable() const {
+            return remaining() - LOCO_CONFIG::DEADLINE_MARGIN * static_cast<float>(budget);
+        }
+
+        /**
+         * @return Time the update is allowed to take, in microseconds
+         */
+        [[nodiscard]] uint32_t getBudget() const {
+            return budget;
+        }
+    };
+}
@@ -1,7 +1,16 @@
 #pragma once
 
+#include "config.h"
 #include "sensorModel.h"
 #include "utils.h"
+#include "rangeTable.h"
+#include "fieldMap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
 namespace loco {
     const std::vector<std::pair<Eigen::Vector2f, Eigen::Vector2f> > WALLS = {
@@ -16,20 +25,552 @@ namespace loco {
     constexpr float WALL_2_X = -1.78308;
     constexpr float WALL_3_Y = -1.78308;
 
+    /**
+     * @brief Reading of a V5 distance sensor, shared by the distance sensor models. Reads the device, tracks whether
+     * the reading is a new sample, and converts it to a measured range and its standard deviation.
+     */
+    class DistanceReading {
+    private:
+        pros::Distance distance;
+
+        QLength measured = 0.0;
+        QLength std = 0.0;
+        bool maxReading = false;
+        int32_t objectSize = 0;
+
+        bool fresh = false;
+        SampleTracker samples;
+        int32_t lastMeasuredMM = -1;
+        int32_t lastObjectSize = -1;
+        int32_t lastConfidence = -1;
+
+    public:
+        /**
+         * @param distance pros::Distance object, moved to this object.
+         */
+        explicit DistanceReading(pros::Distance distance)
+            : distance(std::move(distance)) {
+        }
+
+        /**
+         * @return Distance, object size and confidence read from the sensor
+         */
+        [[nodiscard]] SensorReading acquire() {
+            // Every device call is a separate read and PROS has no combined accessor for the distance sensor, so each
+            // field is read exactly once
+            SensorReading reading;
+            reading.acquired = true;
+            reading.values = {
+                static_cast<double>(distance.get()), static_cast<double>(distance.get_object_size()),
+                static_cast<double>(distance.get_confidence()), 0.0
+            };
+
+            return reading;
+        }
+
+        /**
+         * @brief Update the range, its standard deviation and the freshness from a reading taken by acquire().
+         *
+         * @param reading Reading returned by acquire()
+         */
+        void apply(const SensorReading &reading) {
+            const auto measuredMM = static_cast<int32_t>(reading.values[0]);
+            objectSize = static_cast<int32_t>(reading.values[1]);
+            const auto confidence = static_cast<int32_t>(reading.values[2]);
+
+            // The sensor refreshes slower than the filter runs, an identical reading is usually the previous sample
+            // read again
+            fresh = samples.update(measuredMM != lastMeasuredMM || objectSize != lastObjectSize ||
+                                   confidence != lastConfidence);
+
+            lastMeasuredMM = measuredMM;
+            lastObjectSize = objectSize;
+            lastConfidence = confidence;
+
+            // No object in range reads as 9999
+            maxReading = measuredMM == 9999;
+
+            if (maxReading) {
+                measured = LOCO_CONFIG::DISTANCE_MAX_RANGE;
+                std = 0.20 * measured;
+            } else {
+                measured = measuredMM * millimetre;
+                std = 0.20 * measured / (confidence / 64.0);
+            }
+        }
+
+        /**
+         * @return Whether the last reading is a new sample, see SampleTracker
+         */
+        [[nodiscard]] bool isFresh() const {
+            return fresh;
+        }
+
+        /**
+         * @return Whether the sensor returned no object, in which case the measured range is
+         * LOCO_CONFIG::DISTANCE_MAX_RANGE
+         */
+        [[nodiscard]] bool isMaxReading() const {
+            return maxReading;
+        }
+
+        /**
+         * @return Whether the object is too small to be a field element, usually a game object. Max readings have no
+         * object.
+         */
+        [[nodiscard]] bool isSmallObject() const {
+            return !maxReading && objectSize < 70;
+        }
+
+        /**
+         * @return Whether the standard deviation can weight particles, a confidence of 0 gives every particle the same
+         * weight
+         */
+        [[nodiscard]] bool hasValidStd() const {
+            return std.getValue() > 0.0 && std::isfinite(std.getValue());
+        }
+
+        /**
+         * @return Measured range
+         */
+        [[nodiscard]] QLength getMeasured() const {
+            return measured;
+        }
+
+        /**
+         * @return Standard deviation of the measured range, from the range and the sensor's confidence
+         */
+        [[nodiscard]] QLength getStd() const {
+            return std;
+        }
+    };
+
     /**
      * @brief Sensor model representation of distance sensors pointed directly at the walls on a specified position on the robot.
      *
      * Uses a field model made up of 4 walls, represented by horizontal and vertical lines, and uses secant to predict the
      * distance to the wall and compares this against the measured value.
+     *
+     * Readings are scored with a beam mixture of a Gaussian hit on the predicted wall, an exponential for readings cut
+     * short by unmapped objects such as other robots, a spike for readings that return no object, and a uniform
+     * random reading. For a given reading the mixture only depends on how many standard deviations the predicted range
+     * is from the measured range, so it is tabulated once per reading and each particle costs a table lookup.
      */
     class DistanceSensorModel : public SensorModel {
     private:
         Eigen::Vector3f sensorOffset;
-        pros::Distance distance;
+        DistanceReading reading;
 
-        QLength measured = 0.0;
         bool exit = false;
-        QLength std = 0.0;
+
+        /**
+         * @brief Span of the mixture table on either side of the measured range, in standard deviations. Predicted
+         * ranges outside the span use the value at its edge.
+         */
+        static constexpr float MIXTURE_SPAN = 8.0f;
+        static constexpr size_t MIXTURE_SIZE = LOCO_CONFIG::DISTANCE_MIXTURE_TABLE_SIZE;
+
+        /**
+         * Beam mixture for the current reading, sampled evenly from -MIXTURE_SPAN to MIXTURE_SPAN standard deviations
+         * of the predicted range from the measured range. Each entry holds the value and the change to the next entry,
+         * so an interpolated lookup reads a single pair. The last entry is repeated so the end of the table needs no
+         * special case.
+         */
+        using MixtureTable = std::array<std::array<float, 2>, MIXTURE_SIZE + 2>;
+
+        MixtureTable mixture{};
+
+        /**
+         * Log of the beam mixture, for logPBatch
+         */
+        MixtureTable logMixture{};
+
+        /**
+         * Position of a predicted range in the mixture table is predicted * mixtureSlope + mixtureOffset
+         */
+        float mixtureSlope = 0.0f;
+        float mixtureOffset = 0.0f;
+
+        /**
+         * @brief Ray cast from a sensor to the four walls for a single heading. Each wall's predicted distance is
+         * (c + dx * x + dy * y) * secant, walls facing away from the sensor are set to the 50m default so the
+         * per-particle loop doesn't need to branch.
+         */
+        struct WallTerms {
+            std::array<float, 4> c{}, dx{}, dy{}, secant{};
+
+            /**
+             * @param angle Global heading of the sensor
+             * @param offset Position of the sensor relative to the point predictions are made for
+             */
+            void prepare(const float angle, const Eigen::Vector2f &offset) {
+                // Direction of the normal of each wall, wall 3 faces -y. The angle between the sensor and a wall's normal is
+                // wrapped to [-π, π]
+                constexpr std::array<float, 4> wallAngles = {0.0f, M_PI_2, M_PI, 3.0 * M_PI_2};
+                constexpr std::array<float, 4> wallC = {WALL_0_X, WALL_1_Y, -WALL_2_X, -WALL_3_Y};
+                constexpr std::array<float, 4> wallDx = {-1.0f, 0.0f, 1.0f, 0.0f};
+                constexpr std::array<float, 4> wallDy = {0.0f, -1.0f, 0.0f, 1.0f};
+
+                for (size_t k = 0; k < 4; k++) {
+                    if (const auto wallTheta = std::abs(std::remainder(wallAngles[k] - angle, 2.0f * static_cast<float>(M_PI)));
+                        wallTheta < M_PI_2) {
+                        c[k] = wallC[k] + wallDx[k] * offset.x() + wallDy[k] * offset.y();
+                        dx[k] = wallDx[k];
+                        dy[k] = wallDy[k];
+                        secant[k] = 1.0f / cos(wallTheta);
+                    } else {
+                        c[k] = 50.0f;
+                        dx[k] = 0.0f;
+                        dy[k] = 0.0f;
+                        secant[k] = 1.0f;
+                    }
+                }
+            }
+
+            /**
+             * @return Predicted distance to the nearest wall the sensor faces, for a robot at (x, y)
+             */
+            [[nodiscard]] float predict(const float x, const float y) const {
+                float predicted = 50.0f;
+
+                for (size_t k = 0; k < 4; k++) {
+                    predicted = std::min((c[k] + dx[k] * x + dy[k] * y) * secant[k], predicted);
+                }
+
+                return predicted;
+            }
+        };
+
+        /**
+         * Heading the terms below were computed for, NaN until the first prepare()
+         */
+        float preparedTheta = std::numeric_limits<float>::quiet_NaN();
+
+        WallTerms walls;
+        Eigen::Vector2f rotatedOffset{};
+
+        const RangeTable *rangeTable = nullptr;
+        RangeTable::Slice rangeSlice;
+
+        const FieldMap *fieldMap = nullptr;
+        Eigen::Vector2f direction{};
+
+        /**
+         * @brief Tabulate the beam mixture for the current reading.
+         *
+         * @param maxReading Whether the sensor returned no object, in which case measured is the maximum range
+         */
+        void buildMixture(const bool maxReading) {
+            const float sigma = reading.getStd().getValue();
+            const float measured = reading.getMeasured().getValue();
+            const float maxRange = LOCO_CONFIG::DISTANCE_MAX_RANGE.getValue();
+
+            // The hit term is a density in standard deviations like the single Gaussian it replaces, so the short and
+            // random densities in metres are scaled by the standard deviation to match. The short term leaves out the
+            // normalization by the predicted range, so it is constant for every prediction past the reading.
+            const float shortTerm = LOCO_CONFIG::DISTANCE_Z_SHORT * LOCO_CONFIG::DISTANCE_LAMBDA_SHORT *
+                                    std::exp(-LOCO_CONFIG::DISTANCE_LAMBDA_SHORT * measured) * sigma;
+            const float randomTerm = LOCO_CONFIG::DISTANCE_Z_RAND * sigma / maxRange;
+
+            const float step = 2.0f * MIXTURE_SPAN / static_cast<float>(MIXTURE_SIZE);
+
+            for (size_t k = 0; k <= MIXTURE_SIZE; k++) {
+                const float u = static_cast<float>(k) * step - MIXTURE_SPAN;
+
+                float value;
+
+                if (maxReading) {
+                    // A hit on a wall past the maximum range also reads as no object, the logistic approximates the
+                    // normal CDF of the hit noise. Scaled to the peak of a hit so both kinds of reading weigh
+                    // particles on the same scale.
+                    value = (LOCO_CONFIG::DISTANCE_Z_MAX + LOCO_CONFIG::DISTANCE_Z_HIT / (1.0f + std::exp(-1.702f * u)))
+                            * cheap_norm_pdf(0.0f);
+                } else {
+                    value = LOCO_CONFIG::DISTANCE_Z_HIT * cheap_norm_pdf(u) + (u >= 0.0f ? shortTerm : 0.0f) +
+                            randomTerm;
+                }
+
+                mixture[k][0] = value * LOCO_CONFIG::DISTANCE_WEIGHT;
+            }
+
+            mixture[MIXTURE_SIZE + 1][0] = mixture[MIXTURE_SIZE][0];
+
+            for (size_t k = 0; k <= MIXTURE_SIZE + 1; k++) {
+                logMixture[k][0] = std::log(std::max(mixture[k][0], std::numeric_limits<float>::min()));
+            }
+
+            for (size_t k = 0; k <= MIXTURE_SIZE; k++) {
+                mixture[k][1] = mixture[k + 1][0] - mixture[k][0];
+                logMixture[k][1] = logMixture[k + 1][0] - logMixture[k][0];
+            }
+
+            mixtureSlope = 1.0f / (sigma * step);
+            mixtureOffset = MIXTURE_SPAN / step - measured * mixtureSlope;
+        }
+
+        /**
+         * @brief Probability of the current reading given a predicted range, interpolated from a mixture table.
+         *
+         * @param table mixture or logMixture
+         * @param predicted Predicted range in metres
+         */
+        [[nodiscard]] float mixtureAt(const MixtureTable &table, const float predicted) const {
+            // NaN predictions land on the first entry instead of indexing out of the table
+            const float position = std::min(std::max(0.0f, predicted * mixtureSlope + mixtureOffset),
+                                            static_cast<float>(MIXTURE_SIZE));
+
+            const auto i = static_cast<int32_t>(position);
+
+            return table[i][0] + (position - static_cast<float>(i)) * table[i][1];
+        }
+
+        /**
+         * @brief Add or multiply a value from a mixture table into a weight.
+         *
+         * @tparam Log Whether the table holds log likelihoods that are added to the weights instead of multiplied
+         */
+        template<bool Log>
+        static void combine(float &weight, const float value) {
+            if constexpr (Log) {
+                weight += value;
+            } else {
+                weight *= value;
+            }
+        }
+
+        /**
+         * @brief Weight a batch of particles from their predicted ranges, a full SIMD packet at a time. Shared by the
+         * kernels for a shared heading and for per-particle headings, which only differ in how the ranges are
+         * predicted.
+         *
+         * @tparam Log Whether the table holds log likelihoods that are added to the weights instead of multiplied
+         * @param weights Weight of each particle
+         * @param table mixture or logMixture
+         * @param predictPacket Returns the predicted ranges of the packet of particles starting at an index
+         * @param predictScalar Returns the predicted range of the particle at an index, for the remainder
+         */
+        template<bool Log, typename PredictPacket, typename PredictScalar>
+        void weighPredictions(std::span<float> weights, const MixtureTable &table, PredictPacket predictPacket,
+                              PredictScalar predictScalar) const {
+            using namespace Eigen::internal;
+            using Packet = packet_traits<float>::type;
+            using IndexPacket = packet_traits<int32_t>::type;
+            // The lane counts come from packet_traits, naming __m128 as a template argument drops its alignment
+            // attribute
+            constexpr size_t LANES = packet_traits<float>::size;
+
+            static_assert(packet_traits<int32_t>::size == LANES);
+
+            const Packet slopePacket = pset1<Packet>(mixtureSlope);
+            const Packet offsetPacket = pset1<Packet>(mixtureOffset);
+            const Packet zero = pset1<Packet>(0.0f);
+            const Packet last = pset1<Packet>(static_cast<float>(MIXTURE_SIZE));
+
+            std::array<int32_t, LANES> indices{};
+            std::array<float, LANES> values{}, deltas{};
+
+            size_t i = 0;
+
+            for (; i + LANES <= weights.size(); i += LANES) {
+                const Packet predicted = predictPacket(i);
+
+                Packet position = pmin(pmax(pmadd(predicted, slopePacket, offsetPacket), zero), last);
+
+                // NaN lanes compare unequal to themselves, they land on the first entry like the scalar path
+                position = pselect(pcmp_eq(position, position), position, zero);
+
+                // Positions are never negative, so truncating is the same as rounding down
+                const IndexPacket index = pcast<Packet, IndexPacket>(position);
+                const Packet fraction = psub(position, pcast<IndexPacket, Packet>(index));
+
+                // The table lookup is a gather, which the packet math doesn't have, so only the loads are done per lane
+                pstoreu(indices.data(), index);
+
+                for (size_t lane = 0; lane < LANES; lane++) {
+                    values[lane] = table[indices[lane]][0];
+                    deltas[lane] = table[indices[lane]][1];
+                }
+
+                const Packet value = pmadd(fraction, ploadu<Packet>(deltas.data()), ploadu<Packet>(values.data()));
+                const Packet weight = ploadu<Packet>(weights.data() + i);
+
+                if constexpr (Log) {
+                    pstoreu(weights.data() + i, padd(weight, value));
+                } else {
+                    pstoreu(weights.data() + i, pmul(weight, value));
+                }
+            }
+
+            for (; i < weights.size(); i++) {
+                combine<Log>(weights[i], mixtureAt(table, predictScalar(i)));
+            }
+        }
+
+        /**
+         * @brief Weight a batch of particles with a mixture table, shared by pBatch and logPBatch.
+         *
+         * @tparam Log Whether the table holds log likelihoods that are added to the weights instead of multiplied
+         */
+        template<bool Log>
+        void weigh(std::span<const float> x, std::span<const float> y, const float theta, std::span<float> weights,
+                   const MixtureTable &table) {
+            if (exit) {
+                return;
+            }
+
+            if (theta != preparedTheta) {
+                prepare(theta);
+            }
+
+            if (rangeTable != nullptr || fieldMap != nullptr) {
+                for (size_t i = 0; i < weights.size(); i++) {
+                    combine<Log>(weights[i], mixtureAt(table, predict(x[i], y[i])));
+                }
+
+                return;
+            }
+
+            using namespace Eigen::internal;
+            using Packet = packet_traits<float>::type;
+
+            // Plain arrays, std::array would drop the packet's alignment attribute
+            Packet cPacket[4], dxPacket[4], dyPacket[4], secantPacket[4];
+
+            for (size_t k = 0; k < 4; k++) {
+                cPacket[k] = pset1<Packet>(walls.c[k]);
+                dxPacket[k] = pset1<Packet>(walls.dx[k]);
+                dyPacket[k] = pset1<Packet>(walls.dy[k]);
+                secantPacket[k] = pset1<Packet>(walls.secant[k]);
+            }
+
+            weighPredictions<Log>(weights, table, [&](const size_t i) {
+                const Packet px = ploadu<Packet>(x.data() + i);
+                const Packet py = ploadu<Packet>(y.data() + i);
+
+                Packet predicted = pset1<Packet>(50.0f);
+
+                for (size_t k = 0; k < 4; k++) {
+                    predicted = pmin(pmul(pmadd(dyPacket[k], py, pmadd(dxPacket[k], px, cPacket[k])), secantPacket[k]),
+                                     predicted);
+                }
+
+                return predicted;
+            }, [&](const size_t i) {
+                return walls.predict(x[i], y[i]);
+            });
+        }
+
+        /**
+         * @brief Weight a batch of particles that each have their own heading with a mixture table, shared by
+         * pBatchPose and logPBatchPose. Each particle rotates the sensor offset by its own heading with fast_sin_cos,
+         * and the beam is cast to the walls directly instead of through the per-heading wall terms. With a range table
+         * or field map, each particle looks up or casts its own ray.
+         *
+         * @tparam Log Whether the table holds log likelihoods that are added to the weights instead of multiplied
+         */
+        template<bool Log>
+        void weighPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                       std::span<float> weights, const MixtureTable &table) {
+            if (exit) {
+                return;
+            }
+
+            const float offsetX = sensorOffset.x();
+            const float offsetY = sensorOffset.y();
+            const float offsetCos = std::cos(sensorOffset.z());
+            const float offsetSin = std::sin(sensorOffset.z());
+
+            // Position of the sensor and direction of its beam for the particle at an index
+            const auto beam = [&](const size_t i, float &sensorX, float &sensorY, float &dirX, float &dirY) {
+                float s, c;
+                fast_sin_cos(theta[i], s, c);
+
+                sensorX = x[i] + c * offsetX - s * offsetY;
+                sensorY = y[i] + s * offsetX + c * offsetY;
+                dirX = c * offsetCos - s * offsetSin;
+                dirY = s * offsetCos + c * offsetSin;
+            };
+
+            if (rangeTable != nullptr || fieldMap != nullptr) {
+                for (size_t i = 0; i < weights.size(); i++) {
+                    float sensorX, sensorY, dirX, dirY;
+                    beam(i, sensorX, sensorY, dirX, dirY);
+
+                    const float predicted =
+                            rangeTable != nullptr
+                                ? rangeTable->slice(theta[i] + sensorOffset.z()).lookup(sensorX, sensorY)
+                                : fieldMap->raycast(sensorX, sensorY, dirX, dirY);
+
+                    combine<Log>(weights[i], mixtureAt(table, predicted));
+                }
+
+                return;
+            }
+
+            // Distance along the beam to the wall it faces on each axis. The distance to the wall is taken on the side
+            // the beam points to and divided by the absolute direction, so a beam parallel to a wall gives +infinity
+            // instead of -infinity.
+            const auto toWalls = [](const float sensorX, const float sensorY, const float dirX, const float dirY) {
+                const float xRange = (dirX < 0.0f ? sensorX - WALL_2_X : WALL_0_X - sensorX) / std::abs(dirX);
+                const float yRange = (dirY < 0.0f ? sensorY - WALL_3_Y : WALL_1_Y - sensorY) / std::abs(dirY);
+
+                return std::min(std::min(xRange, yRange), 50.0f);
+            };
+
+            using namespace Eigen::internal;
+            using Packet = packet_traits<float>::type;
+
+            const Packet offsetXPacket = pset1<Packet>(offsetX);
+            const Packet offsetYPacket = pset1<Packet>(offsetY);
+            const Packet offsetCosPacket = pset1<Packet>(offsetCos);
+            const Packet offsetSinPacket = pset1<Packet>(offsetSin);
+            const Packet zero = pset1<Packet>(0.0f);
+
+            weighPredictions<Log>(weights, table, [&](const size_t i) {
+                Packet s, c;
+                fast_sin_cos_packet(ploadu<Packet>(theta.data() + i), s, c);
+
+                const Packet sensorX = psub(pmadd(c, offsetXPacket, ploadu<Packet>(x.data() + i)),
+                                            pmul(s, offsetYPacket));
+                const Packet sensorY = pmadd(c, offsetYPacket, pmadd(s, offsetXPacket, ploadu<Packet>(y.data() + i)));
+                const Packet dirX = psub(pmul(c, offsetCosPacket), pmul(s, offsetSinPacket));
+                const Packet dirY = pmadd(c, offsetSinPacket, pmul(s, offsetCosPacket));
+
+                const Packet xDistance = pselect(pcmp_lt(dirX, zero), psub(sensorX, pset1<Packet>(WALL_2_X)),
+                                                 psub(pset1<Packet>(WALL_0_X), sensorX));
+                const Packet yDistance = pselect(pcmp_lt(dirY, zero), psub(sensorY, pset1<Packet>(WALL_3_Y)),
+                                                 psub(pset1<Packet>(WALL_1_Y), sensorY));
+                const Packet xDir = pabs(dirX);
+                const Packet yDir = pabs(dirY);
+
+                // xDistance / xDir < yDistance / yDir without dividing, so only the nearer wall costs a division
+                const Packet nearerX = pcmp_lt(pmul(xDistance, yDir), pmul(yDistance, xDir));
+
+                return pmin(pdiv(pselect(nearerX, xDistance, yDistance), pselect(nearerX, xDir, yDir)),
+                            pset1<Packet>(50.0f));
+            }, [&](const size_t i) {
+                float sensorX, sensorY, dirX, dirY;
+                beam(i, sensorX, sensorY, dirX, dirY);
+
+                return toWalls(sensorX, sensorY, dirX, dirY);
+            });
+        }
+
+        /**
+         * @brief Predicted distance to the nearest wall the sensor faces, for a robot at (x, y) with the prepared
+         * heading.
+         */
+        [[nodiscard]] float predict(const float x, const float y) const {
+            if (rangeTable != nullptr) {
+                return rangeSlice.lookup(x + rotatedOffset.x(), y + rotatedOffset.y());
+            }
+
+            if (fieldMap != nullptr) {
+                return fieldMap->raycast(x + rotatedOffset.x(), y + rotatedOffset.y(), direction.x(), direction.y());
+            }
+
+            return walls.predict(x, y);
+        }
 
     public:
         /**
@@ -39,20 +580,103 @@ namespace loco {
          */
         DistanceSensorModel(Eigen::Vector3f sensor_offset, pros::Distance distance)
             : sensorOffset(std::move(sensor_offset)),
-              distance(std::move(distance)) {
+              reading(std::move(distance)) {
         }
 
         /**
          * Update sensor reading
          */
         void update() override {
-            const auto measuredMM = distance.get();
+            apply(acquire());
+        }
+
+        /**
+         * @return Distance, object size and confidence read from the sensor
+         */
+        SensorReading acquire() override {
+            return reading.acquire();
+        }
+
+        void apply(const SensorReading &sample) override {
+            reading.apply(sample);
+
+            // Max readings are scored by the max reading part of the mixture
+            exit = reading.isSmallObject() || !reading.hasValidStd();
+
+            if (reading.isFresh() && !exit) {
+                buildMixture(reading.isMaxReading());
+            }
+        }
+
+        /**
+         * @return Whether the last update() read a new sample that can be scored, see SampleTracker. Small objects and
+         * readings without a valid standard deviation aren't scored.
+         */
+        [[nodiscard]] bool isFresh() const override {
+            return reading.isFresh() && !exit;
+        }
+
+        /**
+         * @brief Expected range of a sensor at (x, y) pointing in the direction ø, by ray casting to the walls. Use it
+         * to build a RangeTable for the field.
+         *
+         * @param x x position of the sensor
+         * @param y y position of the sensor
+         * @param angle Global heading of the sensor
+         * @return Distance to the nearest wall in metres
+         */
+        static float rayToWalls(const float x, const float y, const float angle) {
+            WallTerms terms;
+            terms.prepare(angle, Eigen::Vector2f::Zero());
+
+            return terms.predict(x, y);
+        }
+
+        /**
+         * @brief Use a precomputed range table instead of ray casting to the walls. The table can be shared by every
+         * distance sensor on the robot.
+         *
+         * @param table Table built with rayToWalls or a more detailed field model, must outlive the sensor model. nullptr
+         * goes back to ray casting.
+         */
+        void setRangeTable(const RangeTable *table) {
+            rangeTable = table;
+            preparedTheta = std::numeric_limits<float>::quiet_NaN();
+        }
+
+        /**
+         * @brief Ray cast against a map of the field instead of the four perimeter walls, so beams hitting goals,
+         * barriers and other field elements are predicted correctly. A range table takes priority over the map, build
+         * the table from the map to get both.
+         *
+         * @param map Field map, for example FieldMap(WALLS) plus the field elements. Must outlive the sensor model.
+         * nullptr goes back to the perimeter walls.
+         */
+        void setFieldMap(const FieldMap *map) {
+            fieldMap = map;
+            preparedTheta = std::numeric_limits<float>::quiet_NaN();
+        }
+
+        /**
+         * @brief Rotate the sensor offset, pick the walls the sensor faces and compute the secant to each of them, or
+         * pick the slice of the range table. This only depends on the heading, so it is shared by every particle.
+         *
+         * @param theta Heading shared by every particle this frame
+         */
+        void prepare(const float theta) override {
+            const auto angle = theta + sensorOffset.z();
 
-            exit = measuredMM == 9999 || distance.get_object_size() < 70;
+            rotatedOffset = Eigen::Rotation2Df(theta) * sensorOffset.head<2>();
 
-            measured = measuredMM * millimetre;
+            if (rangeTable != nullptr) {
+                rangeSlice = rangeTable->slice(angle);
+            } else if (fieldMap != nullptr) {
+                direction = Eigen::Vector2f(std::cos(angle), std::sin(angle));
+            } else {
+                walls.prepare(angle, rotatedOffset);
+            }
 
-            std = 0.20 * measured / (distance.get_confidence() / 64.0);
+            preparedTheta = theta;
         }
 
         /**
@@ -67,29 +691,67 @@ namespace loco {
                 return std::nullopt;
             }
 
-            auto angle = X.z() + sensorOffset.z();
-
-            Eigen::Vector2f x = X.head<2>() + Eigen::Rotation2Df(X.z()) * sensorOffset.head<2>();
-
-            auto predicted = 50.0f;
-
-            if (const auto theta = abs(std::remainder(0.0f, angle)); theta < M_PI_2) {
-                predicted = std::min((WALL_0_X - x.x()) / cos(theta), predicted);
+            if (X.z() != preparedTheta) {
+                prepare(X.z());
             }
 
-            if (const auto theta = abs(std::remainder(static_cast<float>(M_PI_2), angle)); theta < M_PI_2) {
-                predicted = std::min((WALL_1_Y - x.y()) / cos(theta), predicted);
-            }
+            return mixtureAt(mixture, predict(X.x(), X.y()));
+        }
 
-            if (const auto theta = abs(std::remainder(static_cast<float>(M_PI), angle)); theta < M_PI_2) {
-                predicted = std::min((x.x() - WALL_2_X) / cos(theta), predicted);
-            }
+        /**
+         * @brief Batched version of p(X). Uses the wall terms from prepare(), so every particle costs a few multiplies
+         * and a lookup in the mixture table. The predicted ranges are computed a full SIMD packet at a time (4 lanes
+         * with NEON or SSE, 8 with AVX) using Eigen's packet math, the remainder goes through the scalar path. With a
+         * range table or field map, each prediction is a table lookup or a ray cast instead.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle in the batch
+         * @param weights Weight of each particle, multiplied by the probability of the current reading
+         */
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                    std::span<float> weights) override {
+            weigh<false>(x, y, theta, weights, mixture);
+        }
 
-            if (const auto theta = abs(std::remainder(static_cast<float>(M_3PI_4), angle)); theta < M_PI_2) {
-                predicted = std::min((x.y() - WALL_3_Y) / cos(theta), predicted);
-            }
+        /**
+         * @brief Log version of pBatch, interpolating a table of the log of the mixture so it costs the same as pBatch.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle in the batch
+         * @param logWeights Log weight of each particle, the log probability of the current reading is added to it
+         */
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights) override {
+            weigh<true>(x, y, theta, logWeights, logMixture);
+        }
 
-            return cheap_norm_pdf((predicted - measured.getValue()) / std.getValue()) * LOCO_CONFIG::DISTANCE_WEIGHT;
+        /**
+         * @brief Version of pBatch for particles that each have their own heading. The predicted ranges are computed a
+         * full SIMD packet at a time like pBatch, with the sine and cosine of each heading from fast_sin_cos_packet.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param weights Weight of each particle, multiplied by the probability of the current reading
+         */
+        void pBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                        std::span<float> weights) override {
+            weighPose<false>(x, y, theta, weights, mixture);
+        }
+
+        /**
+         * @brief Log version of pBatchPose, interpolating the table of the log of the mixture.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param logWeights Log weight of each particle, the log probability of the current reading is added to it
+         */
+        void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                           std::span<float> logWeights) override {
+            weighPose<true>(x, y, theta, logWeights, logMixture);
         }
 
         ~DistanceSensorModel() override = default;
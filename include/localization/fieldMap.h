@@ -0,0 +1,272 @@
+#pragma once
+
+#include "Eigen/Eigen"
+#include "units/units.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace loco {
+    /**
+     * @brief Map of the field as a list of line segments, such as the perimeter walls, goals and barriers. The segments
+     * are bucketed into a uniform grid, so a ray cast only tests the segments in the cells the ray passes through and
+     * stops at the first cell containing a hit. The cost of a ray cast grows with the number of cells traversed instead
+     * of the number of segments.
+     */
+    class FieldMap {
+    public:
+        using Segment = std::pair<Eigen::Vector2f, Eigen::Vector2f>;
+
+        /**
+         * @brief Range returned when a ray doesn't hit any segment, matching the miss value of DistanceSensorModel.
+         */
+        static constexpr float MAX_RANGE = 50.0f;
+
+    private:
+        std::vector<Segment> segments;
+
+        float halfSize;
+        size_t cellsPerSide;
+        float cellSize;
+        float inverseCellSize;
+
+        /**
+         * Segments of each cell, cell i holds cellSegments[cellStart[i]] to cellSegments[cellStart[i + 1]]
+         */
+        std::vector<uint32_t> cellStart;
+        std::vector<uint16_t> cellSegments;
+
+        /**
+         * @brief Whether a segment passes through an axis aligned box, by clipping it to the box (Liang-Barsky).
+         */
+        static bool segmentInBox(const Segment &segment, const Eigen::Vector2f &min, const Eigen::Vector2f &max) {
+            const Eigen::Vector2f d = segment.second - segment.first;
+
+            float t0 = 0.0f, t1 = 1.0f;
+
+            for (int axis = 0; axis < 2; axis++) {
+                if (std::abs(d[axis]) < 1e-9f) {
+                    if (segment.first[axis] < min[axis] || segment.first[axis] > max[axis]) {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                float a = (min[axis] - segment.first[axis]) / d[axis];
+                float b = (max[axis] - segment.first[axis]) / d[axis];
+
+                if (a > b) {
+                    std::swap(a, b);
+                }
+
+                t0 = std::max(t0, a);
+                t1 = std::min(t1, b);
+
+                if (t0 > t1) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Distance along a ray to a segment.
+         *
+         * @return Distance to the intersection, or infinity if the ray misses the segment
+         */
+        static float intersect(const Segment &segment, const float x, const float y, const float dirX,
+                               const float dirY) {
+            const float ex = segment.second.x() - segment.first.x();
+            const float ey = segment.second.y() - segment.first.y();
+
+            const float denominator = dirX * ey - dirY * ex;
+
+            if (std::abs(denominator) < 1e-9f) {
+                return std::numeric_limits<float>::infinity();
+            }
+
+            const float wx = segment.first.x() - x;
+            const float wy = segment.first.y() - y;
+
+            const float t = (wx * ey - wy * ex) / denominator;
+            const float s = (wx * dirY - wy * dirX) / denominator;
+
+            if (t < 0.0f || s < 0.0f || s > 1.0f) {
+                return std::numeric_limits<float>::infinity();
+            }
+
+            return t;
+        }
+
+    public:
+        /**
+         * @param segments Line segments making up the field, in metres
+         * @param half_size Distance from the center of the field to its edges, the grid covers the whole field
+         * @param cells_per_side Number of grid cells along each side of the field
+         */
+        explicit FieldMap(std::vector<Segment> segments, const QLength half_size = 1.78308_m,
+                          const size_t cells_per_side = 16)
+            : segments(std::move(segments)),
+              halfSize(half_size.getValue()),
+              cellsPerSide(std::max<size_t>(cells_per_side, 1)),
+              cellSize(2.0f * halfSize / static_cast<float>(cellsPerSide)),
+              inverseCellSize(1.0f / cellSize),
+              cellStart(cellsPerSide * cellsPerSide + 1, 0) {
+            // Segments on a cell boundary belong to the cells on both sides, so the boxes are grown slightly
+            const float margin = cellSize * 1e-3f;
+
+            std::vector<std::vector<uint16_t> > cells(cellsPerSide * cellsPerSide);
+
+            for (size_t i = 0; i < this->segments.size(); i++) {
+                const auto &segment = this->segments[i];
+
+                const auto toCell = [&](const float v) {
+                    return static_cast<size_t>(std::clamp(
+                        std::floor((v + halfSize) * inverseCellSize), 0.0f, static_cast<float>(cellsPerSide - 1)));
+                };
+
+                const size_t minX = toCell(std::min(segment.first.x(), segment.second.x()) - margin);
+                const size_t maxX = toCell(std::max(segment.first.x(), segment.second.x()) + margin);
+                const size_t minY = toCell(std::min(segment.first.y(), segment.second.y()) - margin);
+                const size_t maxY = toCell(std::max(segment.first.y(), segment.second.y()) + margin);
+
+                for (size_t cx = minX; cx <= maxX; cx++) {
+                    for (size_t cy = minY; cy <= maxY; cy++) {
+                        const Eigen::Vector2f min(static_cast<float>(cx) * cellSize - halfSize - margin,
+                                                  static_cast<float>(cy) * cellSize - halfSize - margin);
+                        const Eigen::Vector2f max = min + Eigen::Vector2f::Constant(cellSize + 2.0f * margin);
+
+                        if (segmentInBox(segment, min, max)) {
+                            cells[cx * cellsPerSide + cy].push_back(static_cast<uint16_t>(i));
+                        }
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < cells.size(); i++) {
+                cellStart[i + 1] = cellStart[i] + static_cast<uint32_t>(cells[i].size());
+                cellSegments.insert(cellSegments.end(), cells[i].begin(), cells[i].end());
+            }
+        }
+
+        /**
+         * @brief Distance from a point to the first segment along a direction.
+         *
+         * @param x x position of the start of the ray
+         * @param y y position of the start of the ray
+         * @param dirX x component of the unit direction of the ray
+         * @param dirY y component of the unit direction of the ray
+         * @return Distance to the first segment hit, or MAX_RANGE if the ray doesn't hit anything
+         */
+        [[nodiscard]] float raycast(const float x, const float y, const float dirX, const float dirY) const {
+            // Clip the ray to the grid, rays starting outside the field enter it first
+            float tEnter = 0.0f, tExit = MAX_RANGE;
+
+            const std::array<float, 2> origin = {x, y};
+            const std::array<float, 2> direction = {dirX, dirY};
+
+            for (size_t axis = 0; axis < 2; axis++) {
+                if (std::abs(direction[axis]) < 1e-9f) {
+                    if (origin[axis] < -halfSize || origin[axis] > halfSize) {
+                        return MAX_RANGE;
+                    }
+
+                    continue;
+                }
+
+                float a = (-halfSize - origin[axis]) / direction[axis];
+                float b = (halfSize - origin[axis]) / direction[axis];
+
+                if (a > b) {
+                    std::swap(a, b);
+                }
+
+                tEnter = std::max(tEnter, a);
+                tExit = std::min(tExit, b);
+            }
+
+            if (tEnter > tExit) {
+                return MAX_RANGE;
+            }
+
+            // Walk the cells along the ray (Amanatides & Woo)
+            std::array<long, 2> cell{}, step{};
+            std::array<float, 2> tMax{}, tDelta{};
+
+            for (size_t axis = 0; axis < 2; axis++) {
+                const float start = origin[axis] + tEnter * direction[axis] + halfSize;
+
+                cell[axis] = std::clamp(static_cast<long>(std::floor(start * inverseCellSize)), 0L,
+                                        static_cast<long>(cellsPerSide) - 1);
+
+                if (direction[axis] > 0.0f) {
+                    step[axis] = 1;
+                    tMax[axis] = tEnter + (static_cast<float>(cell[axis] + 1) * cellSize - start) / direction[axis];
+                    tDelta[axis] = cellSize / direction[axis];
+                } else if (direction[axis] < 0.0f) {
+                    step[axis] = -1;
+                    tMax[axis] = tEnter + (static_cast<float>(cell[axis]) * cellSize - start) / direction[axis];
+                    tDelta[axis] = -cellSize / direction[axis];
+                } else {
+                    step[axis] = 0;
+                    tMax[axis] = std::numeric_limits<float>::infinity();
+                    tDelta[axis] = std::numeric_limits<float>::infinity();
+                }
+            }
+
+            float nearest = std::numeric_limits<float>::infinity();
+
+            while (true) {
+                const size_t index = static_cast<size_t>(cell[0]) * cellsPerSide + static_cast<size_t>(cell[1]);
+
+                for (uint32_t i = cellStart[index]; i < cellStart[index + 1]; i++) {
+                    nearest = std::min(nearest, intersect(segments[cellSegments[i]], x, y, dirX, dirY));
+                }
+
+                const size_t axis = tMax[0] < tMax[1] ? 0 : 1;
+                const float cellExit = tMax[axis];
+
+                // A hit inside the current cell can't be beaten by a segment in a later cell
+                if (nearest <= cellExit || cellExit > tExit) {
+                    break;
+                }
+
+                cell[axis] += step[axis];
+
+                if (cell[axis] < 0 || cell[axis] >= static_cast<long>(cellsPerSide)) {
+                    break;
+                }
+
+                tMax[axis] += tDelta[axis];
+            }
+
+            return std::min(nearest, MAX_RANGE);
+        }
+
+        /**
+         * @brief Distance from a point to the first segment in the direction ø.
+         *
+         * @param x x position of the start of the ray
+         * @param y y position of the start of the ray
+         * @param angle Direction of the ray
+         * @return Distance to the first segment hit, or MAX_RANGE if the ray doesn't hit anything
+         */
+        [[nodiscard]] float raycast(const float x, const float y, const float angle) const {
+            return raycast(x, y, std::cos(angle), std::sin(angle));
+        }
+
+        /**
+         * @return Segments making up the map
+         */
+        [[nodiscard]] const std::vector<Segment> &getSegments() const {
+            return segments;
+        }
+    };
+}
@@ -4,10 +4,15 @@
 #include "sensorModel.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
 namespace loco {
     /**
      * @brief A sensor model for the VEX game positioning system. Uses the current position of the sensor and the
-     * .getError() value to determine the confidence of the points
+     * .getError() value to determine the confidence of the points. Particles are scored by their Mahalanobis distance
+     * to the measured position, with the inverse covariance computed once per update from the reported error.
      */
     class GpsSensorModel : public SensorModel {
     private:
@@ -17,6 +22,22 @@ namespace loco {
         double std{0.0};
         bool notInstalled{false};
 
+        /**
+         * Inverse of the covariance of the measured position, the particle's squared Mahalanobis distance is
+         * d^T * invCovariance * d
+         */
+        Eigen::Matrix2f invCovariance{Eigen::Matrix2f::Zero()};
+
+        /**
+         * Yaw of the last sample in the loco coordinate system, read with the position
+         */
+        Angle measuredAngle{0.0};
+
+        bool fresh{false};
+        SampleTracker samples;
+        uint32_t sampleCount{0};
+        Eigen::Vector4f lastSample{Eigen::Vector4f::Constant(std::numeric_limits<float>::quiet_NaN())};
+
     public:
         /**
          *
@@ -29,12 +50,66 @@ namespace loco {
         }
 
         void update() override {
-            notInstalled = !gps.is_installed() || gps.get_error() > 0.015;
-            auto [x, y] = gps.get_position();
+            apply(acquire());
+        }
+
+        /**
+         * @return x, y, yaw and error read from the GPS, or a reading marked as not installed
+         */
+        SensorReading acquire() override {
+            SensorReading reading;
+            reading.acquired = true;
+
+            // Every device call is a separate read, so each field is read once and the position and orientation come
+            // from a single combined read to keep them consistent
+            if (!gps.is_installed()) [[unlikely]] {
+                reading.installed = false;
+                return reading;
+            }
+
+            const pros::gps_status_s_t status = gps.get_position_and_orientation();
+
+            reading.values = {status.x, status.y, status.yaw, gps.get_error()};
+
+            return reading;
+        }
+
+        void apply(const SensorReading &reading) override {
+            if (!reading.installed) [[unlikely]] {
+                notInstalled = true;
+                fresh = false;
+                return;
+            }
+
+            const double error = reading.values[3];
+
+            notInstalled = error > 0.015;
 
-            point = Eigen::Vector2f(-y, x);
+            point = Eigen::Vector2f(-reading.values[1], reading.values[0]);
+            measuredAngle = -reading.values[2] * 1_deg - sensorAngleOffset;
 
-            std = gps.get_error() * 8.0;
+            std = std::max<double>(error * LOCO_CONFIG::GPS_ERROR_SCALE, LOCO_CONFIG::GPS_MIN_STD.getValue());
+
+            // The reported error is a single radius, so the covariance is isotropic
+            invCovariance = Eigen::Matrix2f::Identity() / static_cast<float>(std * std);
+
+            // The GPS refreshes slower than the filter runs, an identical position, yaw and error is usually the
+            // previous sample
+            const Eigen::Vector4f sample(point.x(), point.y(), measuredAngle.getValue(), static_cast<float>(std));
+            fresh = samples.update(sample != lastSample);
+            lastSample = sample;
+
+            if (fresh) {
+                sampleCount++;
+            }
+        }
+
+        /**
+         * @return Whether the last update() read a new sample that can be scored, see SampleTracker. Samples with an
+         * error above 0.015 aren't scored.
+         */
+        [[nodiscard]] bool isFresh() const override {
+            return fresh && !notInstalled;
         }
 
         std::optional<double> p(const Eigen::Vector3f &X) override {
@@ -42,7 +117,95 @@ namespace loco {
                 return std::nullopt;
             }
 
-            return cheap_norm_pdf(sqrt(X.x() * point.x() + X.y() * point.y()) / 2.0f) * LOCO_CONFIG::GPS_WEIGHT;
+            const Eigen::Vector2f d = X.head<2>() - point;
+
+            return cheap_norm_pdf_squared(d.dot(invCovariance * d)) * LOCO_CONFIG::GPS_WEIGHT;
+        }
+
+        /**
+         * @brief Batched version of p(X), weighting a full SIMD packet of particles at a time. Each particle costs a few
+         * multiply-adds for the squared Mahalanobis distance and a cheap_norm_pdf_squared.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle in the batch, unused
+         * @param weights Weight of each particle, multiplied by the probability of the current reading
+         */
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                    std::span<float> weights) override {
+            if (notInstalled) [[unlikely]] {
+                return;
+            }
+
+            const float a = invCovariance(0, 0);
+            const float b = invCovariance(0, 1) + invCovariance(1, 0);
+            const float c = invCovariance(1, 1);
+
+            const auto weigh = [&](const float dx, const float dy) {
+                return cheap_norm_pdf_squared(a * dx * dx + b * dx * dy + c * dy * dy) * LOCO_CONFIG::GPS_WEIGHT;
+            };
+
+            using namespace Eigen::internal;
+            using Packet = packet_traits<float>::type;
+            constexpr size_t LANES = packet_traits<float>::size;
+
+            const Packet pointX = pset1<Packet>(point.x());
+            const Packet pointY = pset1<Packet>(point.y());
+            const Packet aPacket = pset1<Packet>(a);
+            const Packet bPacket = pset1<Packet>(b);
+            const Packet cPacket = pset1<Packet>(c);
+            const Packet weightPacket = pset1<Packet>(LOCO_CONFIG::GPS_WEIGHT);
+
+            size_t i = 0;
+
+            for (; i + LANES <= weights.size(); i += LANES) {
+                const Packet dx = psub(ploadu<Packet>(x.data() + i), pointX);
+                const Packet dy = psub(ploadu<Packet>(y.data() + i), pointY);
+
+                // a * dx^2 + b * dx * dy + c * dy^2, factored as dx * (a * dx + b * dy) + c * dy^2
+                const Packet distance = pmadd(dx, pmadd(aPacket, dx, pmul(bPacket, dy)), pmul(cPacket, pmul(dy, dy)));
+
+                const Packet weight = pmul(cheap_norm_pdf_squared_packet(distance), weightPacket);
+
+                pstoreu(weights.data() + i, pmul(ploadu<Packet>(weights.data() + i), weight));
+            }
+
+            for (; i < weights.size(); i++) {
+                weights[i] *= weigh(x[i] - point.x(), y[i] - point.y());
+            }
+        }
+
+        /**
+         * @brief Same as pBatch, the position of the GPS is scored without the heading of the particles.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle, unused
+         * @param weights Weight of each particle, multiplied by the probability of the current reading
+         */
+        void pBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                        std::span<float> weights) override {
+            GpsSensorModel::pBatch(x, y, 0.0f, weights);
+        }
+
+        /**
+         * @return Number of fresh samples read by update(), used to tell when a new yaw is available
+         */
+        [[nodiscard]] uint32_t getSampleCount() const {
+            return sampleCount;
+        }
+
+        /**
+         * @brief Yaw read with the position by the last update(), without another device read.
+         *
+         * @return Angle in the Loco lib coordinate system, empty if the GPS isn't installed or its error is too large
+         */
+        [[nodiscard]] std::optional<Angle> getMeasuredAngle() const {
+            if (notInstalled) {
+                return std::nullopt;
+            }
+
+            return measuredAngle;
         }
 
         /**
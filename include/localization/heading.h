@@ -0,0 +1,140 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "config.h"
+#include "gps.h"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace loco {
+    /**
+     * @brief Heading of the robot from the IMU, with its drift corrected by the yaw of the GPS through a one
+     * dimensional Kalman filter. The IMU rotation drives the prediction, so the heading stays smooth, and every new GPS
+     * sample pulls it towards the absolute yaw with a gain set by how uncertain the heading has become since the last
+     * sample. Without a GPS, or while the GPS reports a large error, the heading is the IMU rotation.
+     *
+     * The estimator is updated once per frame by the particle filter it is passed to, and the result is cached, so the
+     * filter and every other user of the heading see the same value for the whole frame.
+     */
+    class HeadingEstimator {
+    private:
+        std::function<Angle()> imuRotation;
+        const GpsSensorModel *gps;
+
+        /**
+         * Heading in radians, continuous like the IMU rotation instead of wrapped to a single turn
+         */
+        double heading = 0.0;
+
+        /**
+         * Variance of the heading in radians squared, large until the first GPS sample
+         */
+        double variance = M_PI * M_PI;
+
+        double lastRotation = 0.0;
+        bool initialized = false;
+        bool headingSet = false;
+
+        uint32_t lastGpsSample = 0;
+
+    public:
+        /**
+         * @param imu_rotation Function returning the rotation of the IMU in the loco coordinate system, for example
+         * -imu.get_rotation() * degree
+         * @param gps GPS whose yaw corrects the drift of the IMU, optional. Must outlive the estimator and be updated
+         * by a particle filter.
+         */
+        explicit HeadingEstimator(std::function<Angle()> imu_rotation, const GpsSensorModel *gps = nullptr)
+            : imuRotation(std::move(imu_rotation)),
+              gps(gps) {
+        }
+
+        HeadingEstimator(const HeadingEstimator &) = delete;
+        HeadingEstimator &operator=(const HeadingEstimator &) = delete;
+
+        /**
+         * @brief Sample the IMU once and fuse the GPS sample read since the last update, if there is one. The particle
+         * filter updates the GPS after sampling the heading, so a GPS sample is always a frame older than the IMU one.
+         *
+         * @return Fused heading
+         */
+        Angle update() {
+            const double rotation = imuRotation().getValue();
+
+            // The IMU returns infinity while it is calibrating or unplugged, hold the last heading until it is back
+            if (!std::isfinite(rotation)) {
+                return getAngle();
+            }
+
+            double turned = 0.0;
+
+            if (!initialized) {
+                // Start from the IMU's own heading unless a starting heading was given
+                if (!headingSet) {
+                    heading = rotation;
+                }
+
+                initialized = true;
+            } else {
+                turned = rotation - lastRotation;
+                heading += turned;
+                variance += std::pow(LOCO_CONFIG::HEADING_DRIFT.getValue(), 2);
+            }
+
+            lastRotation = rotation;
+
+            if (gps != nullptr && gps->getSampleCount() != lastGpsSample) {
+                lastGpsSample = gps->getSampleCount();
+
+                if (const auto measured = gps->getMeasuredAngle()) {
+                    // The GPS is read after the heading of its frame was sampled, so its yaw is compared with the
+                    // heading from the last update, before this update's rotation. The yaw is wrapped to a single
+                    // turn, so the innovation is taken on the circle.
+                    const double innovation = std::remainder(measured->getValue() - (heading - turned), 2.0 * M_PI);
+                    const double gain = variance / (variance + std::pow(LOCO_CONFIG::GPS_HEADING_STD.getValue(), 2));
+
+                    heading += gain * innovation;
+                    variance *= 1.0 - gain;
+                }
+            }
+
+            return getAngle();
+        }
+
+        /**
+         * @brief Same as update(), so the estimator can be used in place of an angle function.
+         */
+        Angle operator()() {
+            return update();
+        }
+
+        /**
+         * @return Heading from the last update, without sampling the IMU
+         */
+        [[nodiscard]] Angle getAngle() const {
+            return Angle(static_cast<float>(heading));
+        }
+
+        /**
+         * @return Standard deviation of the heading from the last update
+         */
+        [[nodiscard]] Angle getStd() const {
+            return Angle(static_cast<float>(std::sqrt(variance)));
+        }
+
+        /**
+         * @brief Set the heading, for example to the known starting heading at the beginning of a match.
+         *
+         * @param angle Heading of the robot
+         * @param std Standard deviation of the heading, 0 trusts it until the IMU drifts
+         */
+        void setAngle(const Angle angle, const Angle std = 0.0) {
+            heading = angle.getValue();
+            variance = std::pow(std.getValue(), 2);
+            headingSet = true;
+        }
+    };
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "config.h"
+#include "sensorModel.h"
+#include "distance.h"
+#include "fieldMap.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace loco {
+    /**
+     * @brief Grid of the distance from every point on the field to the nearest field segment (a distance transform).
+     * Built once from the segments of a field map, then each lookup is a single grid fetch. Distances are stored as 16
+     * bit millimetres, a 128x128 grid takes 32KB.
+     */
+    class DistanceField {
+    private:
+        float halfSize;
+        size_t cellsPerSide;
+        float inverseCellSize;
+
+        /**
+         * Distance from the center of each cell to the nearest segment in millimetres, indexed by [x][y]
+         */
+        std::vector<uint16_t> distances;
+
+    public:
+        /**
+         * @brief Distance from a point to the closest point of a segment.
+         *
+         * @param segment Line segment
+         * @param point Point to measure from
+         * @return Distance in the units of the segment
+         */
+        static float distanceToSegment(const FieldMap::Segment &segment, const Eigen::Vector2f &point) {
+            const Eigen::Vector2f d = segment.second - segment.first;
+            const float lengthSquared = d.squaredNorm();
+
+            const float t = lengthSquared > 0.0f
+                                ? std::clamp((point - segment.first).dot(d) / lengthSquared, 0.0f, 1.0f)
+                                : 0.0f;
+
+            return (segment.first + t * d - point).norm();
+        }
+
+        /**
+         * @param segments Line segments making up the field, in metres
+         * @param half_size Distance from the center of the field to its edges
+         * @param cells_per_side Number of grid cells along each side of the field
+         */
+        explicit DistanceField(const std::vector<FieldMap::Segment> &segments, const QLength half_size = 1.78308_m,
+                               const size_t cells_per_side = 128)
+            : halfSize(half_size.getValue()),
+              cellsPerSide(std::max<size_t>(cells_per_side, 1)),
+              inverseCellSize(static_cast<float>(cellsPerSide) / (2.0f * halfSize)),
+              distances(cellsPerSide * cellsPerSide) {
+            const float cellSize = 1.0f / inverseCellSize;
+
+            for (size_t ix = 0; ix < cellsPerSide; ix++) {
+                for (size_t iy = 0; iy < cellsPerSide; iy++) {
+                    const Eigen::Vector2f center((static_cast<float>(ix) + 0.5f) * cellSize - halfSize,
+                                                 (static_cast<float>(iy) + 0.5f) * cellSize - halfSize);
+
+                    float nearest = FieldMap::MAX_RANGE;
+
+                    for (const auto &segment: segments) {
+                        nearest = std::min(nearest, distanceToSegment(segment, center));
+                    }
+
+                    distances[ix * cellsPerSide + iy] = static_cast<uint16_t>(std::min(
+                        std::round(nearest * 1000.0f), static_cast<float>(std::numeric_limits<uint16_t>::max())));
+                }
+            }
+        }
+
+        /**
+         * @brief Distance from a point to the nearest field segment. Points outside the field add their distance to the
+         * edge of the field.
+         *
+         * @param x x position in metres
+         * @param y y position in metres
+         * @return Distance to the nearest segment in metres
+         */
+        [[nodiscard]] float distance(const float x, const float y) const {
+            const float clampedX = std::clamp(x, -halfSize, halfSize);
+            const float clampedY = std::clamp(y, -halfSize, halfSize);
+
+            const auto last = static_cast<long>(cellsPerSide) - 1;
+
+            const auto ix = std::min(static_cast<long>((clampedX + halfSize) * inverseCellSize), last);
+            const auto iy = std::min(static_cast<long>((clampedY + halfSize) * inverseCellSize), last);
+
+            const float outside = std::abs(x - clampedX) + std::abs(y - clampedY);
+
+            return static_cast<float>(distances[ix * cellsPerSide + iy]) * 0.001f + outside;
+        }
+    };
+
+    /**
+     * @brief Likelihood field model for distance sensors. Instead of ray casting to predict the range, the end point of
+     * the measured beam is projected onto the field and scored by its distance to the nearest field segment, read from a
+     * DistanceField. Every particle in a frame shares the heading, so the beam's end point relative to the robot is
+     * computed once per frame, and each particle costs one grid lookup and a cheap_norm_pdf.
+     *
+     * Uses the same sensor offset convention as \refitem DistanceSensorModel.
+     */
+    class LikelihoodFieldSensorModel : public SensorModel {
+    private:
+        Eigen::Vector3f sensorOffset;
+        DistanceReading reading;
+        const DistanceField *field;
+
+        bool exit = false;
+
+        /**
+         * End point of the measured beam in the robot's frame, set by update()
+         */
+        Eigen::Vector2f localEndPoint{};
+
+        /**
+         * End point of the measured beam relative to the robot, for the prepared heading
+         */
+        Eigen::Vector2f endPoint{};
+        float preparedTheta = std::numeric_limits<float>::quiet_NaN();
+
+    public:
+        /**
+         * @param sensor_offset [x, y, ø] of the distance sensor relative to the tracking center of the robot.
+         * @param distance pros::Distance object, moved to this object.
+         * @param field Distance transform of the field, can be shared by every sensor. Must outlive the sensor model.
+         */
+        LikelihoodFieldSensorModel(Eigen::Vector3f sensor_offset, pros::Distance distance, const DistanceField *field)
+            : sensorOffset(std::move(sensor_offset)),
+              reading(std::move(distance)),
+              field(field) {
+        }
+
+        /**
+         * Update sensor reading
+         */
+        void update() override {
+            apply(acquire());
+        }
+
+        /**
+         * @return Distance, object size and confidence read from the sensor
+         */
+        SensorReading acquire() override {
+            return reading.acquire();
+        }
+
+        void apply(const SensorReading &sample) override {
+            reading.apply(sample);
+
+            // A beam that hit nothing has no end point to score
+            exit = reading.isMaxReading() || reading.isSmallObject() || !reading.hasValidStd();
+
+            const float angle = sensorOffset.z();
+
+            localEndPoint = sensorOffset.head<2>() +
+                            reading.getMeasured().getValue() * Eigen::Vector2f(std::cos(angle), std::sin(angle));
+
+            preparedTheta = std::numeric_limits<float>::quiet_NaN();
+        }
+
+        /**
+         * @return Whether the last update() read a new sample that can be scored, see SampleTracker. Max readings,
+         * small objects and readings without a valid standard deviation aren't scored.
+         */
+        [[nodiscard]] bool isFresh() const override {
+            return reading.isFresh() && !exit;
+        }
+
+        /**
+         * @brief Compute the end point of the measured beam relative to the robot, shared by every particle.
+         *
+         * @param theta Heading shared by every particle this frame
+         */
+        void prepare(const float theta) override {
+            endPoint = Eigen::Rotation2Df(theta) * localEndPoint;
+
+            preparedTheta = theta;
+        }
+
+        std::optional<double> p(const Eigen::Vector3f &X) override {
+            if (exit) {
+                return std::nullopt;
+            }
+
+            if (X.z() != preparedTheta) {
+                prepare(X.z());
+            }
+
+            const float distance = field->distance(X.x() + endPoint.x(), X.y() + endPoint.y());
+
+            return cheap_norm_pdf(distance / reading.getStd().getValue()) * LOCO_CONFIG::DISTANCE_WEIGHT;
+        }
+
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                    std::span<float> weights) override {
+            if (exit) {
+                return;
+            }
+
+            if (theta != preparedTheta) {
+                prepare(theta);
+            }
+
+            const float invStd = 1.0f / reading.getStd().getValue();
+
+            for (size_t i = 0; i < weights.size(); i++) {
+                const float weight = cheap_norm_pdf(field->distance(x[i] + endPoint.x(), y[i] + endPoint.y()) * invStd) *
+                                     LOCO_CONFIG::DISTANCE_WEIGHT;
+
+                weights[i] *= std::isfinite(weight) ? weight : 1.0f;
+            }
+        }
+
+        /**
+         * @brief Version of pBatch for particles that each have their own heading, rotating the end point of the beam
+         * by each heading with fast_sin_cos.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param weights Weight of each particle, multiplied by the probability of the current reading
+         */
+        void pBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                        std::span<float> weights) override {
+            if (exit) {
+                return;
+            }
+
+            const float invStd = 1.0f / reading.getStd().getValue();
+
+            for (size_t i = 0; i < weights.size(); i++) {
+                float s, c;
+                fast_sin_cos(theta[i], s, c);
+
+                const float endX = x[i] + c * localEndPoint.x() - s * localEndPoint.y();
+                const float endY = y[i] + s * localEndPoint.x() + c * localEndPoint.y();
+
+                const float weight = cheap_norm_pdf(field->distance(endX, endY) * invStd) *
+                                     LOCO_CONFIG::DISTANCE_WEIGHT;
+
+                weights[i] *= std::isfinite(weight) ? weight : 1.0f;
+            }
+        }
+
+        ~LikelihoodFieldSensorModel() override = default;
+    };
+}
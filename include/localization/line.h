@@ -3,6 +3,14 @@
 #include "config.h"
 #include "sensorModel.h"
 #include "utils.h"
+#include "fieldMap.h"
+#include "likelihoodField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
 
 namespace loco {
 	const std::vector<std::pair<Eigen::Vector2f, Eigen::Vector2f>> LINES = {
@@ -22,6 +30,12 @@ namespace loco {
 		Eigen::Vector2f sensorOffset;
 		pros::adi::LineSensor lineSensor;
 		bool measured{false};
+
+		/**
+		 * y component of the rotated sensor offset, only the y position of the sensor matters for horizontal lines
+		 */
+		float offsetY{0.0f};
+		float preparedTheta{std::numeric_limits<float>::quiet_NaN()};
 	public:
 		LineSensorModel(Eigen::Vector2f sensor_offset, pros::adi::LineSensor line_sensor)
 			: sensorOffset(std::move(sensor_offset)),
@@ -29,16 +43,40 @@ namespace loco {
 		}
 
 		void update() override {
-			measured = this->lineSensor.get_value() < LOCO_CONFIG::LINE_SENSOR_THRESHOLD;
+			apply(acquire());
+		}
+
+		/**
+		 * @return Raw value read from the line sensor
+		 */
+		SensorReading acquire() override {
+			SensorReading reading;
+			reading.acquired = true;
+			reading.values[0] = this->lineSensor.get_value();
+
+			return reading;
+		}
+
+		void apply(const SensorReading &reading) override {
+			measured = reading.values[0] < LOCO_CONFIG::LINE_SENSOR_THRESHOLD;
+		}
+
+		void prepare(const float theta) override {
+			offsetY = (Eigen::Rotation2Df(theta) * sensorOffset).y();
+			preparedTheta = theta;
 		}
 
 		std::optional<double> p(const Eigen::Vector3f& x) override {
-			Eigen::Vector2f sensor_position = Eigen::Rotation2Df(x.z()) * sensorOffset + x.head<2>();
+			if (x.z() != preparedTheta) {
+				prepare(x.z());
+			}
+
+			const float sensorY = x.y() + offsetY;
 
 			auto predictedDistance = 50.0_m;
 
 			for (float lines_y : LINES_Y) {
-				predictedDistance = std::min(abs(sensor_position.y() - lines_y) * metre, predictedDistance);
+				predictedDistance = std::min(abs(sensorY - lines_y) * metre, predictedDistance);
 			}
 
 			const auto predicted = predictedDistance < LOCO_CONFIG::LINE_SENSOR_DISTANCE_THRESHOLD;
@@ -52,6 +90,215 @@ namespace loco {
 			}
 		}
 
+		void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+		            std::span<float> weights) override {
+			if (theta != preparedTheta) {
+				prepare(theta);
+			}
+
+			const float threshold = LOCO_CONFIG::LINE_SENSOR_DISTANCE_THRESHOLD.getValue();
+
+			const float match = 1.0 * LOCO_CONFIG::LINE_WEIGHT;
+			const float mismatch = 0.4 * LOCO_CONFIG::LINE_WEIGHT;
+
+			for (size_t i = 0; i < weights.size(); i++) {
+				const float sensorY = y[i] + offsetY;
+
+				float predictedDistance = 50.0f;
+
+				for (float lines_y : LINES_Y) {
+					predictedDistance = std::min(std::abs(sensorY - lines_y), predictedDistance);
+				}
+
+				const bool predicted = predictedDistance < threshold;
+
+				weights[i] *= predicted == measured ? match : mismatch;
+			}
+		}
+
 		~LineSensorModel() override = default;
 	};
+
+	/**
+	 * @brief Map of the tape on the field as a grid of how much of each cell is covered by tape. Built once from a list
+	 * of tape center lines of any direction or length, then the coverage under a point is a single grid fetch. The
+	 * edges of the tape are blurred by LINE_EDGE_SOFTNESS so the coverage changes smoothly across them. Coverage is
+	 * stored as 8 bit values, a 256x256 grid takes 64KB.
+	 */
+	class LineMap {
+	private:
+		float halfSize;
+		size_t cellsPerSide;
+		float inverseCellSize;
+
+		/**
+		 * Tape coverage of each cell from 0 to 255, indexed by [x][y]
+		 */
+		std::vector<uint8_t> coverage;
+
+	public:
+		/**
+		 * @param segments Center lines of the tape, in metres
+		 * @param half_width Half of the width of the tape
+		 * @param half_size Distance from the center of the field to its edges
+		 * @param cells_per_side Number of grid cells along each side of the field
+		 */
+		explicit LineMap(const std::vector<FieldMap::Segment> &segments = LINES,
+		                 const QLength half_width = LOCO_CONFIG::LINE_SENSOR_DISTANCE_THRESHOLD,
+		                 const QLength half_size = 1.78308_m, const size_t cells_per_side = 256)
+			: halfSize(half_size.getValue()),
+			  cellsPerSide(std::max<size_t>(cells_per_side, 1)),
+			  inverseCellSize(static_cast<float>(cellsPerSide) / (2.0f * halfSize)),
+			  coverage(cellsPerSide * cellsPerSide) {
+			const float cellSize = 1.0f / inverseCellSize;
+			const float softness = LOCO_CONFIG::LINE_EDGE_SOFTNESS.getValue();
+
+			for (size_t ix = 0; ix < cellsPerSide; ix++) {
+				for (size_t iy = 0; iy < cellsPerSide; iy++) {
+					const Eigen::Vector2f center((static_cast<float>(ix) + 0.5f) * cellSize - halfSize,
+					                             (static_cast<float>(iy) + 0.5f) * cellSize - halfSize);
+
+					float nearest = FieldMap::MAX_RANGE;
+
+					for (const auto &segment : segments) {
+						nearest = std::min(nearest, DistanceField::distanceToSegment(segment, center));
+					}
+
+					const float covered = 1.0f / (1.0f + std::exp((nearest - half_width.getValue()) / softness));
+
+					coverage[ix * cellsPerSide + iy] = static_cast<uint8_t>(std::round(covered * 255.0f));
+				}
+			}
+		}
+
+		/**
+		 * @brief How much of a point is covered by tape.
+		 *
+		 * @param x x position in metres
+		 * @param y y position in metres
+		 * @return Coverage from 0 to 1, 0 outside the field
+		 */
+		[[nodiscard]] float coverageAt(const float x, const float y) const {
+			if (std::abs(x) >= halfSize || std::abs(y) >= halfSize) {
+				return 0.0f;
+			}
+
+			const auto ix = static_cast<size_t>((x + halfSize) * inverseCellSize);
+			const auto iy = static_cast<size_t>((y + halfSize) * inverseCellSize);
+
+			return static_cast<float>(coverage[std::min(ix, cellsPerSide - 1) * cellsPerSide +
+			                                   std::min(iy, cellsPerSide - 1)]) * (1.0f / 255.0f);
+		}
+	};
+
+	/**
+	 * @brief Line sensor model for tape in any layout, described by a \refitem LineMap. Instead of thresholding the
+	 * sensor, the raw reflectance is turned into the probability that the sensor is over tape once per update, and
+	 * every particle is scored by how well that agrees with the tape coverage under it. Readings near the threshold
+	 * barely change the weights, while clear readings on or off the tape are a strong correction.
+	 */
+	class LineMapSensorModel : public SensorModel {
+	private:
+		Eigen::Vector2f sensorOffset;
+		pros::adi::LineSensor lineSensor;
+		const LineMap *map;
+
+		/**
+		 * Weight of a particle with no tape under the sensor, and the change in weight for full coverage
+		 */
+		float offTape{1.0f};
+		float slope{0.0f};
+
+		Eigen::Vector2f rotatedOffset{};
+		float preparedTheta{std::numeric_limits<float>::quiet_NaN()};
+
+	public:
+		/**
+		 * @param sensor_offset [x, y] of the line sensor relative to the tracking center of the robot
+		 * @param line_sensor pros::adi::LineSensor object, moved to this object
+		 * @param map Tape on the field, can be shared by every line sensor. Must outlive the sensor model.
+		 */
+		LineMapSensorModel(Eigen::Vector2f sensor_offset, pros::adi::LineSensor line_sensor, const LineMap *map)
+			: sensorOffset(std::move(sensor_offset)),
+			  lineSensor(std::move(line_sensor)),
+			  map(map) {
+		}
+
+		void update() override {
+			apply(acquire());
+		}
+
+		/**
+		 * @return Raw reflectance read from the line sensor
+		 */
+		SensorReading acquire() override {
+			SensorReading reading;
+			reading.acquired = true;
+			reading.values[0] = lineSensor.get_value();
+
+			return reading;
+		}
+
+		void apply(const SensorReading &reading) override {
+			// Lower values are more reflective, so the tape reads below the threshold
+			const auto value = static_cast<float>(reading.values[0]);
+			const float onTape = 1.0f / (1.0f + std::exp((value - LOCO_CONFIG::LINE_SENSOR_THRESHOLD) /
+			                                             LOCO_CONFIG::LINE_SENSOR_SOFTNESS));
+
+			// The likelihood is onTape * coverage + (1 - onTape) * (1 - coverage), scaled to stay above
+			// LINE_MIN_LIKELIHOOD, which is linear in the coverage
+			const float scale = (1.0f - LOCO_CONFIG::LINE_MIN_LIKELIHOOD) * LOCO_CONFIG::LINE_WEIGHT;
+
+			offTape = LOCO_CONFIG::LINE_MIN_LIKELIHOOD * LOCO_CONFIG::LINE_WEIGHT + scale * (1.0f - onTape);
+			slope = scale * (2.0f * onTape - 1.0f);
+		}
+
+		void prepare(const float theta) override {
+			rotatedOffset = Eigen::Rotation2Df(theta) * sensorOffset;
+			preparedTheta = theta;
+		}
+
+		std::optional<double> p(const Eigen::Vector3f &x) override {
+			if (x.z() != preparedTheta) {
+				prepare(x.z());
+			}
+
+			return offTape + slope * map->coverageAt(x.x() + rotatedOffset.x(), x.y() + rotatedOffset.y());
+		}
+
+		void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+		            std::span<float> weights) override {
+			if (theta != preparedTheta) {
+				prepare(theta);
+			}
+
+			for (size_t i = 0; i < weights.size(); i++) {
+				weights[i] *= offTape + slope * map->coverageAt(x[i] + rotatedOffset.x(), y[i] + rotatedOffset.y());
+			}
+		}
+
+		/**
+		 * @brief Version of pBatch for particles that each have their own heading, rotating the sensor offset by each
+		 * heading with fast_sin_cos.
+		 *
+		 * @param x x position of each particle
+		 * @param y y position of each particle
+		 * @param theta Heading of each particle
+		 * @param weights Weight of each particle, multiplied by the probability of the current reading
+		 */
+		void pBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+		                std::span<float> weights) override {
+			for (size_t i = 0; i < weights.size(); i++) {
+				float s, c;
+				fast_sin_cos(theta[i], s, c);
+
+				const float sensorX = x[i] + c * sensorOffset.x() - s * sensorOffset.y();
+				const float sensorY = y[i] + s * sensorOffset.x() + c * sensorOffset.y();
+
+				weights[i] *= offTape + slope * map->coverageAt(sensorX, sensorY);
+			}
+		}
+
+		~LineMapSensorModel() override = default;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "config.h"
+#include "random.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace loco {
+    /**
+     * @brief Defines a MotionModel to be used in the prediction step of the \refitem ParticleFilter. The model is given
+     * every particle at once, so the odometry and any per-frame trigonometry only have to be computed once.
+     */
+    class MotionModel {
+    public:
+        /**
+         * @brief Move every particle by the odometry measured since the last frame, adding noise to each particle.
+         *
+         * @param x x position of each particle, moved in place
+         * @param y y position of each particle, moved in place
+         * @param theta Current heading of the robot
+         * @return Distance the robot travelled this frame, without noise
+         */
+        virtual QLength predict(std::span<float> x, std::span<float> y, float theta) = 0;
+
+        /**
+         * @brief Move every particle by the odometry measured since the last frame, for filters where each particle has
+         * its own heading. Each heading is turned by the rotation of the robot, and models should add noise to it so
+         * the sensors can correct the drift of the heading. The default turns each heading without noise and calls
+         * predict for one particle at a time, override it to move every particle in a single pass.
+         *
+         * @param x x position of each particle, moved in place
+         * @param y y position of each particle, moved in place
+         * @param theta Heading of each particle, turned in place
+         * @param rotation Change in the heading of the robot since the last frame
+         * @return Distance the robot travelled this frame, without noise
+         */
+        virtual QLength predictPose(std::span<float> x, std::span<float> y, std::span<float> theta,
+                                    const float rotation) {
+            QLength travelled = 0.0;
+
+            for (size_t i = 0; i < x.size(); i++) {
+                theta[i] += rotation;
+                travelled = predict(x.subspan(i, 1), y.subspan(i, 1), theta[i]);
+            }
+
+            return travelled;
+        }
+
+        virtual ~MotionModel() = default;
+    };
+
+    /**
+     * @brief Motion model for differential (tank) drives. The average movement of the two sides of the drivetrain is
+     * applied along the robot's heading, with uniform noise on both the distance and the heading. With per-particle
+     * headings, each particle's heading also takes a uniform random step every frame.
+     *
+     * @tparam Random Random number engine used for the noise
+     */
+    template<typename Random = Xoshiro128Plus>
+    class DifferentialDriveMotionModel : public MotionModel {
+    private:
+        /**
+         * Number of noise samples generated at once, the noise buffers are kept on the stack
+         */
+        static constexpr size_t CHUNK_SIZE = 64;
+
+        float driveNoise;
+        Angle angleNoise;
+        Angle headingNoise = LOCO_CONFIG::PARTICLE_HEADING_NOISE;
+
+        QLength displacement = 0.0;
+
+        Random de;
+
+    public:
+        /**
+         * @param drive_noise Noise on the distance travelled, as a fraction of the distance
+         * @param angle_noise Maximum noise added to the heading of each particle
+         * @param random Random number engine, pass a seeded engine for reproducible noise
+         */
+        DifferentialDriveMotionModel(const float drive_noise, const Angle angle_noise, Random random = Random())
+            : driveNoise(drive_noise),
+              angleNoise(angle_noise),
+              de(std::move(random)) {
+        }
+
+        /**
+         * @brief Set the distance the center of the drivetrain moved since the last frame, this should be called once
+         * per frame before ParticleFilter::update.
+         *
+         * @param distance Average distance travelled by the left and right side of the drivetrain
+         */
+        void setDisplacement(const QLength distance) {
+            displacement = distance;
+        }
+
+        /**
+         * @brief Set the noise added to the heading of each particle every frame, for filters with per-particle
+         * headings.
+         *
+         * @param noise Maximum change in a particle's heading per frame, on top of the rotation of the robot
+         */
+        void setHeadingNoise(const Angle noise) {
+            headingNoise = noise;
+        }
+
+        QLength predict(std::span<float> x, std::span<float> y, const float theta) override {
+            const float distance = displacement.getValue();
+            const float distanceNoise = driveNoise * std::abs(distance);
+            const float headingNoise = angleNoise.getValue();
+
+            const float cosTheta = std::cos(theta);
+            const float sinTheta = std::sin(theta);
+
+            std::array<float, CHUNK_SIZE> distanceSamples;
+            std::array<float, CHUNK_SIZE> angleSamples;
+
+            for (size_t start = 0; start < x.size(); start += CHUNK_SIZE) {
+                const size_t n = std::min(CHUNK_SIZE, x.size() - start);
+
+                fillUniform(de, std::span<float>(distanceSamples).first(n), -1.0f, 1.0f);
+                fillUniform(de, std::span<float>(angleSamples).first(n), -1.0f, 1.0f);
+
+                for (size_t i = 0; i < n; i++) {
+                    const float noisy = distance + distanceNoise * distanceSamples[i];
+                    const float a = headingNoise * angleSamples[i];
+                    const float a2 = a * a;
+
+                    // Taylor series of the heading noise, accurate to ~1e-5 for the small angles used here, so the
+                    // only real trig is the shared heading above
+                    const float cosA = 1.0f - a2 * (0.5f - a2 * (1.0f / 24.0f));
+                    const float sinA = a * (1.0f - a2 * (1.0f / 6.0f - a2 * (1.0f / 120.0f)));
+
+                    x[start + i] += noisy * (cosTheta * cosA - sinTheta * sinA);
+                    y[start + i] += noisy * (sinTheta * cosA + cosTheta * sinA);
+                }
+            }
+
+            return Qabs(displacement);
+        }
+
+        QLength predictPose(std::span<float> x, std::span<float> y, std::span<float> theta,
+                            const float rotation) override {
+            const float distance = displacement.getValue();
+            const float distanceNoise = driveNoise * std::abs(distance);
+            const float directionNoise = angleNoise.getValue();
+            const float rotationNoise = headingNoise.getValue();
+
+            using namespace Eigen::internal;
+            using Packet = packet_traits<float>::type;
+            constexpr size_t LANES = packet_traits<float>::size;
+
+            const Packet distancePacket = pset1<Packet>(distance);
+            const Packet distanceNoisePacket = pset1<Packet>(distanceNoise);
+            const Packet directionNoisePacket = pset1<Packet>(directionNoise);
+            const Packet rotationPacket = pset1<Packet>(rotation);
+            const Packet rotationNoisePacket = pset1<Packet>(rotationNoise);
+
+            std::array<float, CHUNK_SIZE> distanceSamples;
+            std::array<float, CHUNK_SIZE> angleSamples;
+            std::array<float, CHUNK_SIZE> headingSamples;
+
+            for (size_t start = 0; start < x.size(); start += CHUNK_SIZE) {
+                const size_t n = std::min(CHUNK_SIZE, x.size() - start);
+
+                fillUniform(de, std::span<float>(distanceSamples).first(n), -1.0f, 1.0f);
+                fillUniform(de, std::span<float>(angleSamples).first(n), -1.0f, 1.0f);
+                fillUniform(de, std::span<float>(headingSamples).first(n), -1.0f, 1.0f);
+
+                size_t i = 0;
+
+                // Every particle has a different heading, so the noise is added to the angle before the trig, which is
+                // done a full SIMD packet at a time
+                for (; i + LANES <= n; i += LANES) {
+                    const Packet heading = pmadd(rotationNoisePacket, ploadu<Packet>(headingSamples.data() + i),
+                                                 padd(ploadu<Packet>(theta.data() + start + i), rotationPacket));
+                    const Packet noisy = pmadd(distanceNoisePacket, ploadu<Packet>(distanceSamples.data() + i),
+                                               distancePacket);
+
+                    Packet sinDirection, cosDirection;
+                    fast_sin_cos_packet(pmadd(directionNoisePacket, ploadu<Packet>(angleSamples.data() + i), heading),
+                                        sinDirection, cosDirection);
+
+                    pstoreu(theta.data() + start + i, heading);
+                    pstoreu(x.data() + start + i, pmadd(noisy, cosDirection, ploadu<Packet>(x.data() + start + i)));
+                    pstoreu(y.data() + start + i, pmadd(noisy, sinDirection, ploadu<Packet>(y.data() + start + i)));
+                }
+
+                for (; i < n; i++) {
+                    const float heading = theta[start + i] + rotation + rotationNoise * headingSamples[i];
+                    const float noisy = distance + distanceNoise * distanceSamples[i];
+
+                    float sinDirection, cosDirection;
+                    fast_sin_cos(heading + directionNoise * angleSamples[i], sinDirection, cosDirection);
+
+                    theta[start + i] = heading;
+                    x[start + i] += noisy * cosDirection;
+                    y[start + i] += noisy * sinDirection;
+                }
+            }
+
+            return Qabs(displacement);
+        }
+
+        ~DifferentialDriveMotionModel() override = default;
+    };
+}
@@ -3,38 +3,85 @@
 #include "Eigen/Eigen"
 #include "units/units.hpp"
 #include "sensorModel.h"
+#include "sensorSet.h"
+#include "motionModel.h"
+#include "particleStorage.h"
+#include "random.h"
+#include "resampler.h"
+#include "snapshot.h"
+#include "profiler.h"
+#include "heading.h"
+#include "deadline.h"
 
 #include <random>
 #include <algorithm>
+#include <bitset>
+#include <concepts>
+#include <functional>
+#include <limits>
+#include <type_traits>
 
 #include "config.h"
 
 namespace loco {
     /**
-     * @brief Initializes a particle filter with a pre-specified number of particles.
+     * @brief Particle filter implementation shared by \refitem ParticleFilter and \refitem DynamicParticleFilter. The
+     * particle buffers are provided by the Storage type, which decides if they are sized at compile time or at runtime,
+     * and if each particle has its own heading.
      *
-     * @warning Due to current efficiency limitations, the particle limit is 500 (Takes approximately 6ms to compute each
-     * frame). For calculating frame time, estimate processing time to be 12µs/particle.
+     * Without per-particle headings, every particle uses the heading from the angle function. With them, the particles
+     * only follow the change in the angle function's heading, with noise from the motion model, so the sensors can
+     * correct IMU drift and bumps. The estimate's heading is then the weighted mean of the particles' headings.
      *
-     * @tparam L Number of particle to initialize the filter with. More is generally better for accuracy, however there are
-     * diminishing returns once the particle count is greater than 100, view warning for notes on large particle quantities.
+     * @warning For calculating frame time, estimate processing time to be 12µs/particle. Use FrameProfiler as the
+     * Profiler to measure it on the robot, or give update() a time budget to bound the time of every update.
+     *
+     * @tparam Storage Particle buffers, FixedParticleStorage, ArenaParticleStorage or their per-particle heading
+     * versions FixedPoseStorage and ArenaPoseStorage
+     * @tparam Random Random number engine used for resampling and for replacing particles outside the field
+     * @tparam Resampler Resampling policy, such as SystematicResampler or MetropolisResampler
+     * @tparam SensorSet Sensors used to weight the particles, DynamicSensorSet or StaticSensorSet
+     * @tparam Profiler Timing of each phase of the update, NullProfiler compiles the instrumentation out
      */
-    template<size_t L>
-    class ParticleFilter {
-        // Ensure particles are less than the max of 500 particles
-        static_assert(std::less_equal<size_t>()(L, 500));
+    template<typename Storage, typename Random = Xoshiro128Plus, typename Resampler = SystematicResampler,
+        typename SensorSet = DynamicSensorSet, typename Profiler = NullProfiler>
+    class BasicParticleFilter {
+    protected:
+        /**
+         * Whether each particle has its own heading, stored in storage.theta
+         */
+        static constexpr bool HEADING = Storage::HEADING;
+        static constexpr bool PROFILED = !std::is_same_v<Profiler, NullProfiler>;
 
-    private:
         /**
-         *
+         * Particle positions are stored as a structure of arrays so they can be handed to SensorModel::pBatch directly
          */
-        std::array<std::array<float, 2>, L> particles;
-        std::array<std::array<float, 2>, L> oldParticles;
-        std::array<float, L> weights;
+        Storage storage;
 
+        /**
+         * Number of particles in use, always less than or equal to the storage capacity
+         */
+        size_t count;
+
+        /**
+         * Latest estimate, only accessed by the task running update()
+         */
         Eigen::Vector3f prediction{};
 
-        std::vector<SensorModel *> sensors;
+        DoubleBufferedSlot<PoseSnapshot> published;
+        uint32_t publishedCount = 0;
+
+        SensorSet sensors;
+
+        /**
+         * Readings taken in another task for the next update, empty when the update reads the devices itself
+         */
+        std::span<const SensorReading> readings;
+
+        /**
+         * Whether every weight is 1, as it is after resampling, so the weights don't need to be converted to logs
+         */
+        bool uniformWeights = true;
 
         QLength distanceSinceUpdate = 0.0;
         QTime lastUpdateTime = 0.0;
@@ -43,161 +90,1164 @@ namespace loco {
         QTime maxUpdateInterval = 2_s;
 
         std::function<Angle()> angleFunction;
-        std::ranlux24_base de;
+
+        /**
+         * Heading sampled from angleFunction at the start of the current frame, shared by every particle
+         */
+        Angle currentAngle = 0.0;
+
+        /**
+         * Last finite heading from angleFunction, and the change to it from the one before, which turns the particles
+         * when they have their own heading
+         */
+        Angle lastAngle = 0.0;
+        bool angleSampled = false;
+        float rotation = 0.0f;
+
+        Random de;
+        Resampler resampler;
+        [[no_unique_address]] Profiler profiler;
 
         std::uniform_real_distribution<> fieldDist{-1.78308, 1.78308};
 
-    public:
-        explicit ParticleFilter(std::function<Angle()> angle_function)
-            : angleFunction(std::move(angle_function)) {
-            for (auto &&particle: particles) {
-                particle[0] = 0.0;
-                particle[1] = 0.0;
+        static constexpr size_t KLD_BINS_PER_SIDE =
+                static_cast<size_t>(2.0 * 1.78308 / LOCO_CONFIG::KLD_BIN_SIZE.getValue()) + 1;
+
+        bool adaptiveParticleCount = false;
+        std::bitset<KLD_BINS_PER_SIDE * KLD_BINS_PER_SIDE> kldBins;
+
+        /**
+         * Short and long term average particle weight for one combination of scored sensors. Each sensor's likelihood
+         * has its own scale, so frames are only compared with frames that scored the same sensors.
+         */
+        struct AverageWeight {
+            uint64_t sensors;
+            double slow;
+            double fast;
+        };
+
+        std::vector<AverageWeight> averageWeights;
+
+        double resampleThreshold = LOCO_CONFIG::RESAMPLE_THRESHOLD;
+
+        /**
+         * Time each part of the correction takes per particle, so updates with a budget can plan how much work fits.
+         * Measured on updates with a budget, and on every update of a profiled filter. Overhead covers everything but
+         * the sensors and resampling.
+         */
+        std::vector<CostEstimate> sensorCosts;
+        std::vector<uint32_t> sensorTimes;
+        std::vector<size_t> sensorOrder;
+        CostEstimate overheadCost;
+        CostEstimate resampleCost;
+
+        /**
+         * @brief Number of particles KLD-sampling needs for the approximation error to stay below
+         * LOCO_CONFIG::KLD_EPSILON, given the number of bins with at least one particle.
+         *
+         * @param occupiedBins Number of bins containing particles
+         * @return Required number of particles
+         */
+        static size_t kldParticleCount(const size_t occupiedBins) {
+            if (occupiedBins <= 1) {
+                return 0;
             }
+
+            const float k = static_cast<float>(occupiedBins - 1);
+            const float a = 2.0f / (9.0f * k);
+            const float b = 1.0f - a + std::sqrt(a) * LOCO_CONFIG::KLD_Z;
+
+            return static_cast<size_t>(std::ceil(k / (2.0f * LOCO_CONFIG::KLD_EPSILON) * b * b * b));
         }
 
-        Eigen::Vector3f getPrediction() {
-            return prediction;
+        static size_t kldBin(const float x, const float y) {
+            const auto toBin = [](const float v) {
+                const auto bin = static_cast<long>((v + 1.78308f) / LOCO_CONFIG::KLD_BIN_SIZE.getValue());
+                return static_cast<size_t>(std::clamp<long>(bin, 0, KLD_BINS_PER_SIDE - 1));
+            };
+
+            return toBin(x) * KLD_BINS_PER_SIDE + toBin(y);
         }
 
-        std::array<Eigen::Vector3f, L> getParticles() {
-            std::array<Eigen::Vector3f, L> particles;
+        /**
+         * @brief Track the short and long term average particle weight (augmented MCL) to detect when the filter is
+         * lost, such as after a collision. The averages are tracked separately for every combination of sensors, since
+         * the average weight of a frame is the product of the likelihoods of the sensors that scored it.
+         *
+         * @param avgWeight Average particle weight of this frame
+         * @param scored Bit i is set if sensor i scored this frame, sensors past the 64th share bits
+         * @return Fraction of the particles to replace with random ones, 0 unless the short term average has dropped
+         * far below the long term average
+         */
+        double updateAverageWeight(const double avgWeight, const uint64_t scored) {
+            auto average = std::find_if(averageWeights.begin(), averageWeights.end(),
+                                        [scored](const AverageWeight &a) { return a.sensors == scored; });
+
+            if (average == averageWeights.end()) {
+                averageWeights.push_back({scored, avgWeight, avgWeight});
+                average = averageWeights.end() - 1;
+            }
 
-            const Angle angle = angleFunction();
+            average->slow += LOCO_CONFIG::RECOVERY_ALPHA_SLOW * (avgWeight - average->slow);
+            average->fast += LOCO_CONFIG::RECOVERY_ALPHA_FAST * (avgWeight - average->fast);
 
-            for (size_t i = 0; i < L; i++) {
-                particles[i] = Eigen::Vector3f(this->particles[i][0], this->particles[i][1], angle.getValue());
+            if (average->fast < LOCO_CONFIG::RECOVERY_WEIGHT_RATIO * average->slow) {
+                return 1.0 - average->fast / average->slow;
             }
 
-            return particles;
+            return 0.0;
         }
 
-        Eigen::Vector3f getParticle(size_t i) {
-            return {this->particles[i][0], this->particles[i][1], angleFunction().getValue()};
-        }
+        /**
+         * @brief Pick the particle count for the next frame with KLD-sampling, or grow back to capacity and inject random
+         * particles if the filter is lost. Must be called right after resampling, while all weights are equal.
+         *
+         * @param randomFraction Fraction of random particles from updateAverageWeight, the filter is lost if above 0
+         */
+        void adaptParticleCount(const double randomFraction) {
+            if (randomFraction > 0.0) {
+                setParticleCount(storage.capacity());
+
+                // Spread the random particles evenly through the set so no part of the belief is removed entirely
+                for (size_t i = 0; i < count; i++) {
+                    if (std::floor(static_cast<double>(i + 1) * randomFraction) >
+                        std::floor(static_cast<double>(i) * randomFraction)) {
+                        // Random particles keep their heading, the heading was tracked by the particles before
+                        storage.x[i] = fieldDist(de);
+                        storage.y[i] = fieldDist(de);
+                    }
+                }
 
-        void update(const std::function<Eigen::Vector2f()> &predictionFunction) {
-            if (!isfinite(angleFunction().getValue())) {
                 return;
             }
 
-            auto start = pros::micros();
+            setParticleCount(std::max(kldParticleCount(kldBins.count()), LOCO_CONFIG::KLD_MIN_PARTICLES));
+        }
+
+        /**
+         * @brief Choose how many particles to weight and which sensors to use so the correction fits in the time left
+         * in the budget. Particles are dropped first, down to LOCO_CONFIG::DEADLINE_MIN_PARTICLES, since resampling
+         * from a random subset still represents the belief. Past that, a random subset of the fresh sensors is kept, a
+         * skipped sensor only loses this frame's sample.
+         *
+         * @param deadline Budget of the update
+         * @return Number of particles to weight, 0 if not even a single sensor fits
+         */
+        size_t planWeighting(const Deadline &deadline) {
+            float perParticle = 0.0f;
+
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (sensors.isFresh(i)) {
+                    perParticle += sensorCosts[i].estimate(1);
+                }
+            }
+
+            const float available = deadline.plannable() - overheadCost.estimate(count);
+
+            if (perParticle * static_cast<float>(count) <= available) {
+                return count;
+            }
+
+            // Weighting fewer particles than the filter has makes resampling mandatory, so it is reserved up front
+            const float subsetAvailable = available - resampleCost.estimate(count);
+            const size_t minimum = std::min(count, LOCO_CONFIG::DEADLINE_MIN_PARTICLES);
+
+            if (subsetAvailable >= perParticle * static_cast<float>(minimum)) {
+                return std::clamp(static_cast<size_t>(subsetAvailable / perParticle), minimum, count);
+            }
+
+            sensorOrder.resize(sensors.size());
+
+            for (size_t i = 0; i < sensorOrder.size(); i++) {
+                const size_t j = uniformIndex(de, i + 1);
+                sensorOrder[i] = sensorOrder[j];
+                sensorOrder[j] = i;
+            }
+
+            float kept = 0.0f;
+            bool anyKept = false;
+
+            for (const size_t i: sensorOrder) {
+                if (!sensors.isFresh(i)) {
+                    continue;
+                }
+
+                const float cost = sensorCosts[i].estimate(minimum);
+
+                if (kept + cost <= subsetAvailable) {
+                    kept += cost;
+                    anyKept = true;
+                } else {
+                    sensors.skip(i);
+                }
+            }
+
+            return anyKept ? minimum : 0;
+        }
+
+        /**
+         * @brief Move a uniformly random subset of the particles to the front of the buffers, with a partial
+         * Fisher-Yates shuffle, so it can be weighted as a single span.
+         *
+         * @param n Number of particles in the subset
+         */
+        void selectParticles(const size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                const size_t j = i + uniformIndex(de, count - i);
+
+                std::swap(storage.x[i], storage.x[j]);
+                std::swap(storage.y[i], storage.y[j]);
+                std::swap(storage.weights[i], storage.weights[j]);
+
+                if constexpr (HEADING) {
+                    std::swap(storage.theta[i], storage.theta[j]);
+                }
+            }
+        }
+
+        /**
+         * @brief Compute the weighted mean and covariance of the particles and publish them to readers in other tasks.
+         *
+         * @param angle Heading of the robot this frame, used when the particles don't have their own heading
+         */
+        void publishEstimate(const Angle angle) {
+            // Accumulated in doubles, the covariance of a converged filter is tiny compared to the positions
+            double totalWeight = 0.0, xSum = 0.0, ySum = 0.0, xxSum = 0.0, yySum = 0.0, xySum = 0.0;
+            double tSum = 0.0, ttSum = 0.0, xtSum = 0.0, ytSum = 0.0;
+
+            // Headings are continuous like the angle function, so they don't need to be wrapped to average them. They
+            // are taken relative to the first particle so the sums stay small after many turns.
+            double reference = 0.0;
+
+            if constexpr (HEADING) {
+                reference = count > 0 ? storage.theta[0] : 0.0;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                const double w = storage.weights[i];
+                const double x = storage.x[i];
+                const double y = storage.y[i];
+
+                totalWeight += w;
+                xSum += w * x;
+                ySum += w * y;
+                xxSum += w * x * x;
+                yySum += w * y * y;
+                xySum += w * x * y;
 
-            const Angle angle = angleFunction();
+                if constexpr (HEADING) {
+                    const double t = storage.theta[i] - reference;
 
-            for (auto &&particle: particles) {
-                auto prediction = predictionFunction();
-                particle[0] += prediction.x();
-                particle[1] += prediction.y();
+                    tSum += w * t;
+                    ttSum += w * t * t;
+                    xtSum += w * x * t;
+                    ytSum += w * y * t;
+                }
+            }
+
+            if (totalWeight <= 0.0) {
+                return;
             }
 
-            distanceSinceUpdate += predictionFunction().norm();
+            const double meanX = xSum / totalWeight;
+            const double meanY = ySum / totalWeight;
+            const double meanT = tSum / totalWeight;
+
+            const auto varianceX = static_cast<float>(xxSum / totalWeight - meanX * meanX);
+            const auto varianceY = static_cast<float>(yySum / totalWeight - meanY * meanY);
+            const auto covarianceXY = static_cast<float>(xySum / totalWeight - meanX * meanY);
+
+            // Without per-particle headings every particle shares the heading, so it has no variance
+            const auto varianceT = static_cast<float>(ttSum / totalWeight - meanT * meanT);
+            const auto covarianceXT = static_cast<float>(xtSum / totalWeight - meanX * meanT);
+            const auto covarianceYT = static_cast<float>(ytSum / totalWeight - meanY * meanT);
+
+            const float heading = HEADING ? static_cast<float>(reference + meanT) : angle.getValue();
+
+            prediction = Eigen::Vector3f(static_cast<float>(meanX), static_cast<float>(meanY), heading);
+
+            PoseSnapshot snapshot;
+            snapshot.pose = {prediction.x(), prediction.y(), prediction.z()};
+            snapshot.covariance = {
+                varianceX, covarianceXY, covarianceXT,
+                covarianceXY, varianceY, covarianceYT,
+                covarianceXT, covarianceYT, varianceT,
+            };
+            snapshot.timestamp = pros::micros();
+            snapshot.sequence = publishedCount++;
+
+            published.store(snapshot);
+        }
+
+        /**
+         * @brief Run the sensor update and resampling once the robot has moved far enough or enough time has passed
+         * since the last update. Particle weights carry over between updates, resampling only runs once the effective
+         * sample size drops below the resample threshold. Sensors without a new sample are skipped, and if no sensor
+         * has one, the update is retried next frame.
+         *
+         * With a limited deadline, the work is planned with planWeighting() from the measured cost of each part. When
+         * fewer than every particle are weighted, the particles are resampled from the weighted ones. When resampling
+         * is due but doesn't fit in the time left, it is deferred to a later update.
+         *
+         * @param angle Heading of the robot this frame
+         * @param deadline Budget of the update
+         * @param report Filled with how much the correction was degraded
+         */
+        void correct(const Angle angle, const Deadline &deadline, DeadlineReport &report) {
+            const std::span<float> particlesX = std::span<float>(storage.x).first(count);
+            const std::span<float> particlesY = std::span<float>(storage.y).first(count);
+            const std::span<float> oldParticlesX = std::span<float>(storage.oldX).first(count);
+            const std::span<float> oldParticlesY = std::span<float>(storage.oldY).first(count);
+            const std::span<float> weights = std::span<float>(storage.weights).first(count);
+            const std::span<float> particlesTheta = std::span<float>(storage.theta).first(HEADING ? count : 0);
+            const std::span<float> oldParticlesTheta = std::span<float>(storage.oldTheta).first(HEADING ? count : 0);
 
             if (distanceSinceUpdate < maxDistanceSinceUpdate && maxUpdateInterval > pros::millis() * millisecond) {
                 return;
             }
 
-            for (auto &&sensor: this->sensors) {
-                sensor->update();
+            uint32_t start = profiler.now();
+
+            // Without a new sample the readings carry no new information, so the update waits for the next frame
+            if (!(readings.empty() ? sensors.update() : sensors.apply(readings))) {
+                profiler.record(Phase::SensorUpdate, start);
+
+                return;
             }
 
-            double totalWeight = 0.0;
+            // Without a budget or a profiler, the update isn't timed at all
+            const bool timed = deadline.isTimed();
+            const uint32_t correctionStart = deadline.elapsed();
 
-            for (size_t i = 0; i < L; i++) {
-                weights[i] = 1.0;
+            if (timed) {
+                sensorCosts.resize(sensors.size());
+                sensorTimes.assign(sensors.size(), 0);
+            }
+
+            for (size_t i = 0; i < sensors.size(); i++) {
+                report.sensorsFresh += sensors.isFresh(i);
+            }
+
+            const size_t weighted = deadline.limited() ? planWeighting(deadline) : count;
+
+            for (size_t i = 0; i < sensors.size(); i++) {
+                report.sensorsWeighted += sensors.isFresh(i);
+            }
+
+            // Not even one sensor fits, the correction is retried next frame like one without a new sample
+            if (weighted == 0) {
+                profiler.record(Phase::SensorUpdate, start);
+
+                return;
+            }
+
+            if constexpr (!HEADING) {
+                sensors.prepare(angle.getValue());
+            }
+
+            profiler.record(Phase::SensorUpdate, start);
+            start = profiler.now();
+
+            if (weighted < count) {
+                selectParticles(weighted);
+            }
+
+            const std::span<float> weightedX = particlesX.first(weighted);
+            const std::span<float> weightedY = particlesY.first(weighted);
+            const std::span<float> weightedWeights = weights.first(weighted);
+
+            // The likelihoods are accumulated as logs, the product of several sensors that disagree can underflow a
+            // float and would leave every particle with a weight of 0
+            Eigen::Map<Eigen::ArrayXf> logWeights(weights.data(), static_cast<Eigen::Index>(weighted));
+
+            if (uniformWeights) {
+                logWeights.setZero();
+            } else {
+                logWeights = logWeights.max(std::numeric_limits<float>::min()).log();
+            }
+
+            for (size_t i = 0; i < weighted; i++) {
+                if (outOfField(particlesX[i], particlesY[i])) {
+                    particlesX[i] = fieldDist(de);
+                    particlesY[i] = fieldDist(de);
+                    weights[i] = 0.0f;
+                }
+            }
 
-                if (outOfField(particles[i])) {
-                    particles[i][0] = fieldDist(de);
-                    particles[i][1] = fieldDist(de);
+            const auto weigh = [&](auto &sensorProfiler) {
+                if constexpr (HEADING) {
+                    sensors.logPBatchPose(weightedX, weightedY, particlesTheta.first(weighted), weightedWeights,
+                                          sensorProfiler);
+                } else {
+                    sensors.logPBatch(weightedX, weightedY, angle.getValue(), weightedWeights, sensorProfiler);
                 }
+            };
+
+            uint32_t sensorTime = 0;
 
-                auto particle = Eigen::Vector3f(particles[i][0], particles[i][1], angle.getValue());
+            if (timed) {
+                SensorTimer<Profiler> timer(profiler, sensorTimes);
+                weigh(timer);
 
-                for (const auto sensor: sensors) {
-                    if (auto weight = sensor->p(particle); weight.has_value() && isfinite(weight.value())) {
-                        weights[i] = weights[i] * weight.value();
+                for (size_t i = 0; i < sensors.size(); i++) {
+                    if (sensors.isFresh(i)) {
+                        sensorCosts[i].add(sensorTimes[i], weighted);
+                        sensorTime += sensorTimes[i];
                     }
                 }
+            } else {
+                weigh(profiler);
+            }
+
+            report.corrected = true;
+            report.particlesWeighted = weighted;
+
+            profiler.record(Phase::Likelihood, start);
+            start = profiler.now();
+
+            // Subtracting the largest log weight before the exponent gives the best particle a weight of 1, so the
+            // weights can't all underflow. The scale is kept separately for the average likelihood.
+            const float maxLogWeight = logWeights.maxCoeff();
+
+            if (std::isfinite(maxLogWeight)) {
+                logWeights = (logWeights - maxLogWeight).exp();
+            }
 
-                weights[i] = weights[i];
+            // Weights are normalized to a mean of 1 after every update, so the average weight is the average
+            // likelihood of this frame's readings
+            double totalWeight = 0.0;
+            double totalSquaredWeight = 0.0;
 
-                totalWeight = totalWeight + weights[i];
+            for (size_t i = 0; i < weighted; i++) {
+                totalWeight += weights[i];
+                totalSquaredWeight += weights[i] * weights[i];
             }
 
-            if (totalWeight == 0.0) {
-                std::cout << "Warning: Total weight equal to 0" << std::endl;
+            // Weights can't underflow anymore, this is only reached if a sensor returned NaN or infinity. Readings that
+            // no particle explains go through the normal path, with a tiny average likelihood that flags the filter as
+            // lost.
+            if (!std::isfinite(maxLogWeight) || !std::isfinite(totalWeight)) {
+                report.weightsInvalid = true;
+
+                std::fill(weights.begin(), weights.end(), 1.0f);
+                uniformWeights = true;
+
+                profiler.record(Phase::Normalization, start);
+
                 return;
             }
 
-            const double avgWeight = totalWeight / static_cast<double>(L);
+            const double avgWeight = totalWeight / static_cast<double>(weighted);
 
-            std::uniform_real_distribution distribution(0.0, avgWeight);
-            const double randWeight = distribution(de);
+            uint64_t scored = 0;
 
-            for (size_t i = 0; i < particles.size(); i++) {
-                oldParticles[i] = particles[i];
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (sensors.isFresh(i)) {
+                    scored |= uint64_t{1} << (i % 64);
+                }
             }
 
-            size_t j = 0;
-            auto cumulativeWeight = 0.0;
+            const double randomFraction =
+                    adaptiveParticleCount
+                            ? updateAverageWeight(avgWeight * std::exp(static_cast<double>(maxLogWeight)), scored)
+                            : 0.0;
+            const bool lost = randomFraction > 0.0;
 
-            float xSum = 0.0, ySum = 0.0;
+            const double effectiveSampleSize = totalWeight * totalWeight / totalSquaredWeight;
 
-            for (size_t i = 0; i < L; i++) {
-                const auto weight = static_cast<double>(i) * avgWeight + randWeight;
+            const bool resamplingDue = lost || effectiveSampleSize < resampleThreshold * static_cast<double>(count);
 
-                while (cumulativeWeight < weight) {
-                    if (j >= weights.size()) {
-                        break;
-                    }
-                    cumulativeWeight += weights[j];
-                    j++;
+            // Resampling from the weighted particles can't be deferred, the other particles have no weight yet
+            report.resamplingDeferred = resamplingDue && weighted == count && deadline.limited() &&
+                                        deadline.plannable() < resampleCost.estimate(count);
+
+            if (weighted == count && (!resamplingDue || report.resamplingDeferred)) {
+                const float normalization = static_cast<float>(1.0 / avgWeight);
+
+                for (size_t i = 0; i < count; i++) {
+                    weights[i] *= normalization;
+                }
+
+                uniformWeights = false;
+
+                profiler.record(Phase::Normalization, start);
+                start = profiler.now();
+
+                publishEstimate(angle);
+
+                profiler.record(Phase::Estimate, start);
+
+                if (timed) {
+                    overheadCost.add(deadline.elapsed() - correctionStart - sensorTime, count);
+                }
+
+                lastUpdateTime = pros::millis() * millisecond;
+                distanceSinceUpdate = 0.0;
+
+                return;
+            }
+
+            profiler.record(Phase::Normalization, start);
+            start = profiler.now();
+
+            const uint32_t resampleStart = deadline.elapsed();
+
+            const std::span<uint32_t> ancestors = std::span<uint32_t>(storage.ancestors).first(count);
+
+            resampler.resample(weightedWeights, totalWeight, ancestors, de);
+
+            // Ancestors are always among the weighted particles, which are at the front of the buffers
+            std::copy(weightedX.begin(), weightedX.end(), oldParticlesX.begin());
+            std::copy(weightedY.begin(), weightedY.end(), oldParticlesY.begin());
+            std::copy_n(particlesTheta.begin(), HEADING ? weighted : 0, oldParticlesTheta.begin());
+
+            kldBins.reset();
+
+            for (size_t i = 0; i < count; i++) {
+                particlesX[i] = oldParticlesX[ancestors[i]];
+                particlesY[i] = oldParticlesY[ancestors[i]];
+
+                if constexpr (HEADING) {
+                    particlesTheta[i] = oldParticlesTheta[ancestors[i]];
+                }
+
+                if (adaptiveParticleCount) {
+                    kldBins.set(kldBin(particlesX[i], particlesY[i]));
                 }
+            }
+
+            std::fill(weights.begin(), weights.end(), 1.0f);
+            uniformWeights = true;
+
+            const uint32_t estimateStart = profiler.now();
+            const uint32_t resampleTime = deadline.elapsed() - resampleStart;
+
+            publishEstimate(angle);
 
-                particles[i][0] = oldParticles[j - 1][0];
-                particles[i][1] = oldParticles[j - 1][1];
+            profiler.record(Phase::Estimate, estimateStart);
 
-                xSum += particles[i][0];
-                ySum += particles[i][1];
+            // The particle count adaptation is part of resampling, so only the estimate is left out of its time
+            start += profiler.now() - estimateStart;
+
+            const size_t resampledCount = count;
+
+            if (adaptiveParticleCount) {
+                adaptParticleCount(randomFraction);
             }
 
-            prediction = Eigen::Vector3f(xSum / static_cast<float>(L), ySum / static_cast<float>(L), angle.getValue());
+            profiler.record(Phase::Resampling, start);
+
+            if (timed) {
+                resampleCost.add(resampleTime, resampledCount);
+                overheadCost.add(deadline.elapsed() - correctionStart - sensorTime - resampleTime, resampledCount);
+            }
 
             lastUpdateTime = pros::millis() * millisecond;
             distanceSinceUpdate = 0.0;
         }
 
+        /**
+         * @brief Sample the heading for a frame, the angle function is only called here.
+         *
+         * @return Heading of the robot, also cached for the rest of the frame
+         */
+        Angle sampleAngle() {
+            currentAngle = angleFunction();
+
+            // A sample that isn't finite doesn't turn the particles, the next finite sample includes the rotation
+            if (isfinite(currentAngle.getValue())) {
+                rotation = angleSampled ? (currentAngle - lastAngle).getValue() : 0.0f;
+                lastAngle = currentAngle;
+                angleSampled = true;
+            }
+
+            return currentAngle;
+        }
+
+        /**
+         * @brief Point every particle at the last finite heading from the angle function, when the particles have their
+         * own heading.
+         */
+        void resetHeadings() {
+            if constexpr (HEADING) {
+                std::fill_n(storage.theta.begin(), count, lastAngle.getValue());
+            }
+        }
+
+        /**
+         * @brief Move every particle with a prediction function and turn the particles with their own heading.
+         *
+         * @param predictionFunction Function returning the noisy movement of a single particle in the global frame
+         * @return Function moving the particles and returning the distance the robot travelled
+         */
+        auto predictWith(const std::function<Eigen::Vector2f()> &predictionFunction) {
+            return [this, &predictionFunction]() -> QLength {
+                for (size_t i = 0; i < count; i++) {
+                    auto prediction = predictionFunction();
+                    storage.x[i] += prediction.x();
+                    storage.y[i] += prediction.y();
+
+                    if constexpr (HEADING) {
+                        storage.theta[i] += rotation;
+                    }
+                }
+
+                return predictionFunction().norm();
+            };
+        }
+
+        /**
+         * @brief Move every particle with a motion model.
+         *
+         * @param motionModel Motion model holding the odometry since the last frame
+         * @return Function moving the particles and returning the distance the robot travelled
+         */
+        auto predictWith(MotionModel &motionModel) {
+            return [this, &motionModel]() -> QLength {
+                if constexpr (HEADING) {
+                    return motionModel.predictPose(std::span<float>(storage.x).first(count),
+                                                   std::span<float>(storage.y).first(count),
+                                                   std::span<float>(storage.theta).first(count), rotation);
+                } else {
+                    return motionModel.predict(std::span<float>(storage.x).first(count),
+                                               std::span<float>(storage.y).first(count), currentAngle.getValue());
+                }
+            };
+        }
+
+        /**
+         * @brief Run one update, moving the particles and then correcting them within the deadline.
+         *
+         * @param predict Function moving the particles and returning the distance the robot travelled
+         * @param deadline Budget of the update
+         * @return How much the update was degraded to fit in the budget
+         */
+        template<typename Predict>
+        DeadlineReport step(Predict &&predict, const Deadline &deadline) {
+            DeadlineReport report;
+            report.budget = deadline.getBudget();
+            report.particleCount = count;
+
+            if (count == 0 || !isfinite(sampleAngle().getValue())) {
+                readings = {};
+                report.elapsed = deadline.elapsed();
+
+                return report;
+            }
+
+            const uint32_t start = profiler.now();
+
+            distanceSinceUpdate += predict();
+
+            profiler.record(Phase::Prediction, start);
+
+            correct(currentAngle, deadline, report);
+
+            profiler.record(Phase::Frame, start);
+            profiler.endFrame();
+
+            readings = {};
+            report.elapsed = deadline.elapsed();
+
+            return report;
+        }
+
+    public:
+        /**
+         * @param angle_function Function returning the current heading of the robot, called once per update
+         * @param sensor_set Sensors used to weight the particles
+         * @param storage_args Arguments forwarded to the Storage constructor
+         */
+        template<typename... StorageArgs>
+        BasicParticleFilter(std::function<Angle()> angle_function, SensorSet sensor_set,
+                            StorageArgs &&... storage_args)
+            : storage(std::forward<StorageArgs>(storage_args)...),
+              count(storage.capacity()),
+              sensors(std::move(sensor_set)),
+              angleFunction(std::move(angle_function)) {
+            std::fill_n(storage.x.begin(), count, 0.0f);
+            std::fill_n(storage.y.begin(), count, 0.0f);
+            std::fill_n(storage.weights.begin(), count, 1.0f);
+            resetHeadings();
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         * @param sensor_set Sensors used to weight the particles
+         * @param storage_args Arguments forwarded to the Storage constructor
+         */
+        template<typename... StorageArgs>
+        BasicParticleFilter(HeadingEstimator &heading, SensorSet sensor_set, StorageArgs &&... storage_args)
+            : BasicParticleFilter(std::function<Angle()>(std::ref(heading)), std::move(sensor_set),
+                                  std::forward<StorageArgs>(storage_args)...) {
+        }
+
+        /**
+         * @brief Get the current estimate of the robot's pose. Safe to call from any task while another task runs
+         * update().
+         *
+         * @return [x, y, ø] of the robot in metres and radians
+         */
+        Eigen::Vector3f getPrediction() const {
+            return published.load().getPose();
+        }
+
+        /**
+         * @brief Get a consistent snapshot of the estimate, with its covariance and the time it was computed. Safe to
+         * call from any task while another task runs update(), and never blocks the update.
+         *
+         * @return Latest published estimate
+         */
+        PoseSnapshot getSnapshot() const {
+            return published.load();
+        }
+
+        std::vector<Eigen::Vector3f> getParticles() {
+            std::vector<Eigen::Vector3f> particles(count);
+
+            for (size_t i = 0; i < count; i++) {
+                particles[i] = getParticle(i);
+            }
+
+            return particles;
+        }
+
+        Eigen::Vector3f getParticle(size_t i) {
+            if constexpr (HEADING) {
+                return {storage.x[i], storage.y[i], storage.theta[i]};
+            } else {
+                return {storage.x[i], storage.y[i], currentAngle.getValue()};
+            }
+        }
+
+        /**
+         * @return Number of particles currently in use
+         */
+        [[nodiscard]] size_t getParticleCount() const {
+            return count;
+        }
+
+        /**
+         * @return Maximum number of particles the filter can hold
+         */
+        [[nodiscard]] size_t getCapacity() const {
+            return storage.capacity();
+        }
+
+        /**
+         * @brief Change the number of particles in use, for example to use fewer particles once the filter has
+         * converged. New particles are copies of the existing ones, so the belief is unchanged.
+         *
+         * @param particleCount Number of particles, clamped to [1, capacity]
+         */
+        void setParticleCount(const size_t particleCount) {
+            if (storage.capacity() == 0) {
+                return;
+            }
+
+            const size_t newCount = std::clamp<size_t>(particleCount, 1, storage.capacity());
+
+            if (newCount < count) {
+                // Thin the particles evenly instead of truncating, resampled particles are grouped by their origin
+                for (size_t i = 0; i < newCount; i++) {
+                    storage.x[i] = storage.x[i * count / newCount];
+                    storage.y[i] = storage.y[i * count / newCount];
+                    storage.weights[i] = storage.weights[i * count / newCount];
+
+                    if constexpr (HEADING) {
+                        storage.theta[i] = storage.theta[i * count / newCount];
+                    }
+                }
+            }
+
+            for (size_t i = count; i < newCount; i++) {
+                storage.x[i] = storage.x[i % count];
+                storage.y[i] = storage.y[i % count];
+                storage.weights[i] = storage.weights[i % count];
+
+                if constexpr (HEADING) {
+                    storage.theta[i] = storage.theta[i % count];
+                }
+            }
+
+            count = newCount;
+        }
+
+        /**
+         * @brief Enable KLD-sampling to adapt the number of particles in use. After each resample the particle count is
+         * set to the number needed to represent the belief (see LOCO_CONFIG::KLD_EPSILON), between
+         * LOCO_CONFIG::KLD_MIN_PARTICLES and the capacity. When the average particle weight drops suddenly, such as
+         * after a collision, the filter grows back to its capacity and injects uniformly random particles to recover.
+         *
+         * @param enabled Whether the particle count should adapt
+         */
+        void setAdaptiveParticleCount(const bool enabled) {
+            adaptiveParticleCount = enabled;
+
+            if (!enabled) {
+                setParticleCount(storage.capacity());
+            }
+        }
+
+        /**
+         * @return Deadline of an update without a budget. Only a profiled filter measures these updates, which keeps
+         * the cost estimates current for updates with a budget.
+         */
+        static Deadline unlimited() {
+            if constexpr (PROFILED) {
+                return Deadline::measured();
+            } else {
+                return Deadline();
+            }
+        }
+
+        /**
+         * @brief Update the filter with a prediction function that is called once per particle to get its noisy
+         * movement since the last frame. Particles with their own heading are turned by the rotation of the robot,
+         * without noise.
+         *
+         * @param predictionFunction Function returning the noisy movement of a single particle in the global frame
+         */
+        void update(const std::function<Eigen::Vector2f()> &predictionFunction) {
+            step(predictWith(predictionFunction), unlimited());
+        }
+
+        /**
+         * @brief Update the filter with a prediction function, degrading the correction to fit in a time budget. The
+         * prediction and the sensor reads always run. With the time left, fewer particles are weighted and resampled
+         * from, then a random subset of the sensors is used, and resampling that doesn't fit is deferred. The cost of
+         * each part is measured on every update with a budget, so the first updates of a new configuration can overrun
+         * it. A budget too small for the prediction and the work every particle needs skips every correction, use fewer
+         * particles if the report is never corrected.
+         *
+         * @param predictionFunction Function returning the noisy movement of a single particle in the global frame
+         * @param budget Time the update is allowed to take
+         * @return How much the update was degraded to fit in the budget
+         */
+        DeadlineReport update(const std::function<Eigen::Vector2f()> &predictionFunction, const QTime budget) {
+            return step(predictWith(predictionFunction), Deadline(budget));
+        }
+
+        /**
+         * @brief Update the filter with a motion model, which moves every particle in a single call. Particles with
+         * their own heading are moved with MotionModel::predictPose.
+         *
+         * @param motionModel Motion model holding the odometry since the last frame
+         */
+        void update(MotionModel &motionModel) {
+            step(predictWith(motionModel), unlimited());
+        }
+
+        /**
+         * @brief Update the filter with a motion model, degrading the correction to fit in a time budget. See the
+         * prediction function overload for how the update degrades.
+         *
+         * @param motionModel Motion model holding the odometry since the last frame
+         * @param budget Time the update is allowed to take
+         * @return How much the update was degraded to fit in the budget
+         */
+        DeadlineReport update(MotionModel &motionModel, const QTime budget) {
+            return step(predictWith(motionModel), Deadline(budget));
+        }
+
         void initNormal(const Eigen::Vector2f &mean, const Eigen::Matrix2f &covariance, const bool flip) {
-            for (auto &&particle: this->particles) {
+            const Angle angle = sampleAngle();
+
+            for (size_t i = 0; i < count; i++) {
                 Eigen::Vector2f p = mean + covariance * Eigen::Vector2f::Random();
-                particle[0] = p.x();
-                particle[1] = p.y() * (flip ? -1.0 : 1.0);
+                storage.x[i] = p.x();
+                storage.y[i] = p.y() * (flip ? -1.0 : 1.0);
             }
 
-            prediction.z() = angleFunction().getValue();
+            resetHeadings();
+
+            std::fill_n(storage.weights.begin(), count, 1.0f);
+            uniformWeights = true;
+
+            publishEstimate(angle);
             distanceSinceUpdate += 2.0 * distanceSinceUpdate;
         }
 
-        static bool outOfField(const std::array<float, 2> &vector) {
-            return vector[0] > 1.78308 || vector[0] < -1.78308 || vector[1] < -1.78308 || vector[1] > 1.78308;
+        static bool outOfField(const float x, const float y) {
+            return x > 1.78308 || x < -1.78308 || y < -1.78308 || y > 1.78308;
         }
 
         void initUniform(const QLength minX, const QLength minY, const QLength maxX, const QLength maxY) {
-            std::uniform_real_distribution xDistribution(minX.getValue(), maxX.getValue());
-            std::uniform_real_distribution yDistribution(minY.getValue(), maxY.getValue());
+            fillUniform(de, std::span<float>(storage.x).first(count), minX.getValue(), maxX.getValue());
+            fillUniform(de, std::span<float>(storage.y).first(count), minY.getValue(), maxY.getValue());
 
-            for (auto &&particle: this->particles) {
-                particle[0] = xDistribution(de);
-                particle[1] = yDistribution(de);
+            if constexpr (HEADING) {
+                sampleAngle();
+                resetHeadings();
             }
+
+            std::fill_n(storage.weights.begin(), count, 1.0f);
+            uniformWeights = true;
         }
 
-        void addSensor(SensorModel *sensor) {
-            this->sensors.emplace_back(sensor);
+        /**
+         * @brief Set the effective sample size, as a fraction of the particle count, below which the particles are
+         * resampled. Above it, weights carry over to the next update instead, which saves the resampling work and
+         * keeps more distinct particles alive. 1.0 resamples on every update.
+         *
+         * @param threshold Fraction of the particle count, between 0.0 and 1.0
+         */
+        void setResampleThreshold(const double threshold) {
+            resampleThreshold = threshold;
         }
 
-        Angle getAngle() {
-            return angleFunction();
+        /**
+         * @brief Get the resampler, for example to tune its parameters.
+         *
+         * @return The filter's resampler
+         */
+        Resampler &getResampler() {
+            return resampler;
+        }
+
+        /**
+         * @brief Get the profiler, to read the time spent in each phase of the update when FrameProfiler is used.
+         *
+         * @return The filter's profiler
+         */
+        Profiler &getProfiler() {
+            return profiler;
+        }
+
+        /**
+         * @brief Get the random number engine, for example to seed it so a log replay is reproducible.
+         *
+         * @return The filter's random number engine
+         */
+        Random &getRandom() {
+            return de;
+        }
+
+        void addSensor(SensorModel *sensor) requires std::same_as<SensorSet, DynamicSensorSet> {
+            this->sensors.add(sensor);
+        }
+
+        /**
+         * @brief Use sensor readings taken in another task with SensorSet::acquire() for the next update, instead of
+         * reading the devices during the update. Used by \refitem LocalizationPipeline.
+         *
+         * @param sensorReadings Reading of each sensor, must stay valid until the next update returns
+         */
+        void useReadings(std::span<const SensorReading> sensorReadings) {
+            readings = sensorReadings;
+        }
+
+        /**
+         * @return The sensors used to weight the particles
+         */
+        SensorSet &getSensors() {
+            return sensors;
+        }
+
+        /**
+         * @return Heading of the robot sampled at the start of the last update
+         */
+        Angle getAngle() const {
+            return currentAngle;
+        }
+    };
+
+    /**
+     * @brief Initializes a particle filter with a pre-specified number of particles.
+     *
+     * @warning The particle buffers are stored inside the filter object, so large particle counts make large objects.
+     * Use \refitem DynamicParticleFilter to size the filter at runtime. For calculating frame time, estimate processing
+     * time to be 12µs/particle.
+     *
+     * @tparam L Number of particle to initialize the filter with. More is generally better for accuracy, however there are
+     * diminishing returns once the particle count is greater than 100, view warning for notes on large particle quantities.
+     * @tparam Random Random number engine, Xoshiro128Plus by default
+     * @tparam Resampler Resampling policy, SystematicResampler by default
+     * @tparam Profiler Update timing, NullProfiler by default
+     */
+    template<size_t L, typename Random = Xoshiro128Plus, typename Resampler = SystematicResampler,
+        typename Profiler = NullProfiler>
+    class ParticleFilter : public BasicParticleFilter<FixedParticleStorage<L>, Random, Resampler, DynamicSensorSet,
+                Profiler> {
+        using Base = BasicParticleFilter<FixedParticleStorage<L>, Random, Resampler, DynamicSensorSet, Profiler>;
+
+    public:
+        explicit ParticleFilter(std::function<Angle()> angle_function)
+            : Base(std::move(angle_function), DynamicSensorSet()) {
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         */
+        explicit ParticleFilter(HeadingEstimator &heading)
+            : Base(heading, DynamicSensorSet()) {
+        }
+
+        /**
+         * @brief Get every particle in the filter. If fewer than L particles are in use, the active particles are
+         * repeated to fill the array.
+         *
+         * @return Array of all the particles
+         */
+        std::array<Eigen::Vector3f, L> getParticles() {
+            std::array<Eigen::Vector3f, L> particles;
+
+            const Angle angle = this->currentAngle;
+
+            for (size_t i = 0; i < L; i++) {
+                const size_t j = i % this->count;
+                particles[i] = Eigen::Vector3f(this->storage.x[j], this->storage.y[j], angle.getValue());
+            }
+
+            return particles;
+        }
+    };
+
+    /**
+     * @brief Particle filter where each particle has its own heading, so distance sensors and other sensors that depend
+     * on the heading can correct the drift of the IMU and bumps that turn the robot. The angle function only gives the
+     * rotation of the robot each frame, the particles add noise to it through the motion model (see
+     * DifferentialDriveMotionModel::setHeadingNoise), and getPrediction() returns the particles' mean heading.
+     *
+     * @warning Every sensor model computes the sine and cosine of each particle's heading, so weighting a particle
+     * costs about twice as much as in \refitem ParticleFilter.
+     *
+     * @tparam L Number of particles
+     * @tparam Random Random number engine, Xoshiro128Plus by default
+     * @tparam Resampler Resampling policy, SystematicResampler by default
+     * @tparam Profiler Update timing, NullProfiler by default
+     */
+    template<size_t L, typename Random = Xoshiro128Plus, typename Resampler = SystematicResampler,
+        typename Profiler = NullProfiler>
+    class PoseParticleFilter : public BasicParticleFilter<FixedPoseStorage<L>, Random, Resampler, DynamicSensorSet,
+                Profiler> {
+        using Base = BasicParticleFilter<FixedPoseStorage<L>, Random, Resampler, DynamicSensorSet, Profiler>;
+
+    public:
+        /**
+         * @param angle_function Function returning the current heading of the robot, called once per update. The
+         * particles start at this heading and follow its changes.
+         */
+        explicit PoseParticleFilter(std::function<Angle()> angle_function)
+            : Base(std::move(angle_function), DynamicSensorSet()) {
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         */
+        explicit PoseParticleFilter(HeadingEstimator &heading)
+            : Base(heading, DynamicSensorSet()) {
+        }
+    };
+
+    /**
+     * @brief Particle filter with the number of particles chosen at runtime. The particle buffers are either placed in a
+     * caller supplied arena or in a single aligned allocation, so the filter object itself stays small.
+     *
+     * @tparam Random Random number engine, Xoshiro128Plus by default
+     * @tparam Resampler Resampling policy, SystematicResampler by default
+     * @tparam Profiler Update timing, NullProfiler by default
+     */
+    template<typename Random = Xoshiro128Plus, typename Resampler = SystematicResampler,
+        typename Profiler = NullProfiler>
+    class DynamicParticleFilter : public BasicParticleFilter<ArenaParticleStorage, Random, Resampler, DynamicSensorSet,
+                Profiler> {
+        using Base = BasicParticleFilter<ArenaParticleStorage, Random, Resampler, DynamicSensorSet, Profiler>;
+
+    public:
+        /**
+         * @param angle_function Function returning the current heading of the robot, called once per update
+         * @param capacity Maximum number of particles, the filter starts with this many particles in use
+         */
+        DynamicParticleFilter(std::function<Angle()> angle_function, const size_t capacity)
+            : Base(std::move(angle_function), DynamicSensorSet(), capacity) {
+        }
+
+        /**
+         * @param angle_function Function returning the current heading of the robot, called once per update
+         * @param arena Memory for the particle buffers, must outlive the filter. Use
+         * ArenaParticleStorage::requiredBytes() to size it.
+         * @param capacity Maximum number of particles, reduced if the arena is too small
+         */
+        DynamicParticleFilter(std::function<Angle()> angle_function, std::span<std::byte> arena, const size_t capacity)
+            : Base(std::move(angle_function), DynamicSensorSet(), arena, capacity) {
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         * @param capacity Maximum number of particles, the filter starts with this many particles in use
+         */
+        DynamicParticleFilter(HeadingEstimator &heading, const size_t capacity)
+            : Base(heading, DynamicSensorSet(), capacity) {
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         * @param arena Memory for the particle buffers, must outlive the filter. Use
+         * ArenaParticleStorage::requiredBytes() to size it.
+         * @param capacity Maximum number of particles, reduced if the arena is too small
+         */
+        DynamicParticleFilter(HeadingEstimator &heading, std::span<std::byte> arena, const size_t capacity)
+            : Base(heading, DynamicSensorSet(), arena, capacity) {
+        }
+    };
+
+    /**
+     * @brief Particle filter with its sensors fixed at compile time. The sensors are stored by value, so the weighting
+     * loop calls each sensor's pBatch directly instead of through a virtual call, letting the compiler inline and fuse
+     * the per-particle work of every sensor. Use \refitem ParticleFilter when sensors need to be added at runtime, and
+     * \refitem ComposedParticleFilter for the default engine, resampler and profiler.
+     *
+     * @tparam L Number of particles
+     * @tparam Random Random number engine
+     * @tparam Resampler Resampling policy
+     * @tparam Profiler Update timing
+     * @tparam Sensors Sensor model types, each deriving from SensorModel
+     */
+    template<size_t L, typename Random, typename Resampler, typename Profiler, typename... Sensors>
+    class BasicComposedParticleFilter : public BasicParticleFilter<FixedParticleStorage<L>, Random, Resampler,
+                StaticSensorSet<Sensors...>, Profiler> {
+        using Base = BasicParticleFilter<FixedParticleStorage<L>, Random, Resampler, StaticSensorSet<Sensors...>,
+            Profiler>;
+
+    public:
+        /**
+         * @param angle_function Function returning the current heading of the robot, called once per update
+         * @param sensors Sensor models, copied into the filter
+         */
+        explicit BasicComposedParticleFilter(std::function<Angle()> angle_function, Sensors... sensors)
+            : Base(std::move(angle_function), StaticSensorSet<Sensors...>(std::move(sensors)...)) {
+        }
+
+        /**
+         * @param heading Heading estimator, updated once per update. Must outlive the filter.
+         * @param sensors Sensor models, copied into the filter
+         */
+        explicit BasicComposedParticleFilter(HeadingEstimator &heading, Sensors... sensors)
+            : Base(heading, StaticSensorSet<Sensors...>(std::move(sensors)...)) {
+        }
+
+        /**
+         * @brief Get one of the filter's sensors.
+         *
+         * @tparam I Index of the sensor in the template parameters
+         * @return Reference to the sensor
+         */
+        template<size_t I>
+        auto &getSensor() {
+            return this->sensors.template get<I>();
         }
     };
+
+    /**
+     * @brief \refitem BasicComposedParticleFilter with Xoshiro128Plus, SystematicResampler and NullProfiler. The
+     * sensors come last in the template parameters, so the other policies can only be changed through
+     * BasicComposedParticleFilter.
+     *
+     * @tparam L Number of particles
+     * @tparam Sensors Sensor model types, each deriving from SensorModel
+     */
+    template<size_t L, typename... Sensors>
+    using ComposedParticleFilter = BasicComposedParticleFilter<L, Xoshiro128Plus, SystematicResampler, NullProfiler,
+        Sensors...>;
 }
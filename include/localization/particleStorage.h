@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+
+namespace loco {
+    /**
+     * @brief Particle buffers stored inline in the filter object, sized at compile time. This is what
+     * \refitem ParticleFilter uses, so a global filter's buffers end up in the program's static memory.
+     *
+     * @tparam L Number of particles to reserve space for
+     * @tparam Heading Whether each particle has its own heading, stored in theta. Without it the heading buffers are
+     * empty and every particle uses the heading of the robot.
+     */
+    template<size_t L, bool Heading = false>
+    class FixedParticleStorage {
+    public:
+        /**
+         * @brief Whether each particle has its own heading.
+         */
+        static constexpr bool HEADING = Heading;
+
+        alignas(16) std::array<float, L> x;
+        alignas(16) std::array<float, L> y;
+        alignas(16) std::array<float, Heading ? L : 0> theta;
+        alignas(16) std::array<float, L> oldX;
+        alignas(16) std::array<float, L> oldY;
+        alignas(16) std::array<float, Heading ? L : 0> oldTheta;
+        alignas(16) std::array<float, L> weights;
+        alignas(16) std::array<uint32_t, L> ancestors;
+
+        /**
+         * @return The maximum number of particles the storage can hold
+         */
+        static constexpr size_t capacity() {
+            return L;
+        }
+    };
+
+    /**
+     * @brief Particle buffers sized at runtime. The buffers are either carved out of a caller supplied arena, or out of a
+     * single aligned allocation owned by the storage, so a filter can be sized per robot without recompiling. Use
+     * ArenaParticleStorage or ArenaPoseStorage.
+     *
+     * @tparam Heading Whether each particle has its own heading, stored in theta. Without it the heading buffers are
+     * empty and take no space in the arena.
+     */
+    template<bool Heading>
+    class BasicArenaParticleStorage {
+    public:
+        /**
+         * @brief Whether each particle has its own heading.
+         */
+        static constexpr bool HEADING = Heading;
+
+        /**
+         * @brief Alignment of each buffer in the arena, large enough for a NEON or SSE load.
+         */
+        static constexpr size_t ALIGNMENT = 16;
+
+        /**
+         * @brief Number of 4 byte buffers stored per particle (x, y, old x, old y, weight and ancestor, plus theta and
+         * old theta with a heading).
+         */
+        static constexpr size_t BUFFERS = Heading ? 8 : 6;
+
+        std::span<float> x;
+        std::span<float> y;
+        std::span<float> theta;
+        std::span<float> oldX;
+        std::span<float> oldY;
+        std::span<float> oldTheta;
+        std::span<float> weights;
+        std::span<uint32_t> ancestors;
+
+    private:
+        static_assert(sizeof(float) == sizeof(uint32_t));
+
+        struct AlignedDelete {
+            void operator()(std::byte *buffer) const {
+                ::operator delete[](buffer, std::align_val_t(ALIGNMENT));
+            }
+        };
+
+        std::unique_ptr<std::byte[], AlignedDelete> owned;
+
+        static constexpr size_t stride(const size_t capacity) {
+            // Round each buffer up so the following buffer stays aligned
+            constexpr size_t floatsPerAlignment = ALIGNMENT / sizeof(float);
+            return (capacity + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+        }
+
+        void assign(std::byte *buffer, const size_t capacity) {
+            const size_t s = stride(capacity) * sizeof(float);
+
+            x = {reinterpret_cast<float *>(buffer), capacity};
+            y = {reinterpret_cast<float *>(buffer + s), capacity};
+            oldX = {reinterpret_cast<float *>(buffer + 2 * s), capacity};
+            oldY = {reinterpret_cast<float *>(buffer + 3 * s), capacity};
+            weights = {reinterpret_cast<float *>(buffer + 4 * s), capacity};
+            ancestors = {reinterpret_cast<uint32_t *>(buffer + 5 * s), capacity};
+
+            if constexpr (Heading) {
+                theta = {reinterpret_cast<float *>(buffer + 6 * s), capacity};
+                oldTheta = {reinterpret_cast<float *>(buffer + 7 * s), capacity};
+            }
+        }
+
+    public:
+        /**
+         * @brief Number of bytes an arena needs to hold the given number of particles, not including any padding
+         * needed to align the start of the arena.
+         *
+         * @param capacity Number of particles
+         * @return Size of the arena in bytes
+         */
+        static constexpr size_t requiredBytes(const size_t capacity) {
+            return BUFFERS * stride(capacity) * sizeof(float);
+        }
+
+        /**
+         * @brief Allocate the buffers for the particles in a single aligned allocation.
+         *
+         * @param capacity Maximum number of particles
+         */
+        explicit BasicArenaParticleStorage(const size_t capacity)
+            : owned(static_cast<std::byte *>(::operator new[](requiredBytes(capacity), std::align_val_t(ALIGNMENT)))) {
+            assign(owned.get(), capacity);
+        }
+
+        /**
+         * @brief Use a caller supplied arena for the particle buffers. The arena must outlive the storage. If the arena
+         * is too small for the requested capacity, the capacity is reduced to the number of particles that fit.
+         *
+         * @param arena Memory to place the particle buffers in
+         * @param capacity Maximum number of particles
+         */
+        BasicArenaParticleStorage(std::span<std::byte> arena, size_t capacity) {
+            void *start = arena.data();
+            size_t space = arena.size();
+
+            if (std::align(ALIGNMENT, 0, start, space) == nullptr) {
+                space = 0;
+            }
+
+            while (capacity > 0 && requiredBytes(capacity) > space) {
+                capacity = space / (BUFFERS * sizeof(float));
+                capacity -= std::min(capacity, ALIGNMENT / sizeof(float));
+            }
+
+            assign(static_cast<std::byte *>(start), capacity);
+        }
+
+        /**
+         * @return The maximum number of particles the storage can hold
+         */
+        [[nodiscard]] size_t capacity() const {
+            return x.size();
+        }
+    };
+
+    /**
+     * @brief Particle buffers sized at runtime, every particle uses the heading of the robot. This is what
+     * \refitem DynamicParticleFilter uses.
+     */
+    using ArenaParticleStorage = BasicArenaParticleStorage<false>;
+
+    /**
+     * @brief Particle buffers sized at runtime with a heading for each particle.
+     */
+    using ArenaPoseStorage = BasicArenaParticleStorage<true>;
+
+    /**
+     * @brief Particle buffers sized at compile time with a heading for each particle. This is what
+     * \refitem PoseParticleFilter uses.
+     *
+     * @tparam L Number of particles to reserve space for
+     */
+    template<size_t L>
+    using FixedPoseStorage = FixedParticleStorage<L, true>;
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "sensorModel.h"
+#include "deadline.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+
+namespace loco {
+    /**
+     * @brief Lock-free ring buffer for a single producer task and a single consumer task. Neither side ever blocks or
+     * disables interrupts, each index is only written by one side, and a value is published by the release store of the
+     * producer's index after the slot is written.
+     *
+     * @tparam T Value type, copied in and out of the ring
+     * @tparam N Capacity of the ring, a power of two
+     */
+    template<typename T, size_t N>
+    class SpscRing {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "The capacity must be a power of two");
+
+    private:
+        std::array<T, N> slots{};
+
+        /**
+         * Next slot to pop, only written by the consumer
+         */
+        std::atomic<uint32_t> head{0};
+
+        /**
+         * Next slot to push, only written by the producer
+         */
+        std::atomic<uint32_t> tail{0};
+
+    public:
+        /**
+         * @brief Add a value to the ring. Must only be called from the producer task.
+         *
+         * @param value Value to add
+         * @return Whether the value was added, false if the ring is full
+         */
+        bool push(const T &value) {
+            const uint32_t t = tail.load(std::memory_order_relaxed);
+
+            if (t - head.load(std::memory_order_acquire) == N) {
+                return false;
+            }
+
+            slots[t % N] = value;
+            tail.store(t + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief Take the oldest value out of the ring. Must only be called from the consumer task.
+         *
+         * @param value Set to the oldest value, unchanged if the ring is empty
+         * @return Whether a value was taken
+         */
+        bool pop(T &value) {
+            const uint32_t h = head.load(std::memory_order_relaxed);
+
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            value = slots[h % N];
+            head.store(h + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @return Number of values in the ring, may be out of date by the time it returns
+         */
+        [[nodiscard]] size_t size() const {
+            // Loading the head first keeps the tail at or past it, but the ring can be emptied and refilled in between
+            const uint32_t h = head.load(std::memory_order_acquire);
+            const uint32_t t = tail.load(std::memory_order_acquire);
+
+            return std::min<size_t>(t - h, N);
+        }
+    };
+
+    /**
+     * @brief Everything the acquisition task of a \refitem LocalizationPipeline reads in one frame.
+     *
+     * @tparam MaxSensors Number of sensor readings in the frame
+     */
+    template<size_t MaxSensors>
+    struct SensorFrame {
+        /**
+         * @brief Time the frame was read, from pros::micros().
+         */
+        uint64_t timestamp = 0;
+
+        /**
+         * @brief Total distance travelled by the robot in metres, from the odometry function.
+         */
+        float distance = 0.0f;
+
+        /**
+         * @brief Heading of the robot in radians, from the rotation function.
+         */
+        float rotation = 0.0f;
+
+        /**
+         * @brief Reading of each sensor, in the order the sensors were added to the filter.
+         */
+        std::array<SensorReading, MaxSensors> readings{};
+    };
+
+    /**
+     * @brief Runs localization as two tasks. A small high priority acquisition task samples the odometry, the IMU and
+     * every sensor's device on a fixed period, timestamps them and pushes them into an \refitem SpscRing. The weighting
+     * task takes the latest frame whenever one is ready and runs the particle filter update on it. Jitter in reading
+     * the sensors no longer delays the update, and the update can take longer than a frame without the readings
+     * falling behind, since it always works on the latest frame.
+     *
+     * The particle filter has to use getRotation() as its angle function, so it sees the heading read with the rest of
+     * the frame. Sensors are read with SensorModel::acquire(), sensors that don't support it are read by the update in
+     * the weighting task. Add every sensor before starting the pipeline.
+     *
+     * @tparam MaxSensors Number of sensors read by the acquisition task, extra sensors are read by the update
+     * @tparam Capacity Number of frames the ring holds, frames read while it is full are dropped
+     */
+    template<size_t MaxSensors = 8, size_t Capacity = 4>
+    class LocalizationPipeline {
+    private:
+        std::function<QLength()> odometry;
+        std::function<Angle()> imuRotation;
+
+        SpscRing<SensorFrame<MaxSensors>, Capacity> ring;
+
+        /**
+         * Frame being used by the weighting task, the sensor readings are handed to the filter from here
+         */
+        SensorFrame<MaxSensors> frame;
+        float lastDistance = 0.0f;
+
+        /**
+         * Heading of the frame being used, published for getRotation() since it can be called from other tasks
+         */
+        std::atomic<float> rotation{0.0f};
+        std::atomic<bool> started{false};
+
+        /**
+         * Statistics, written by one task and safe to read from any task
+         */
+        std::atomic<uint32_t> droppedFrames{0};
+        std::atomic<uint32_t> skippedFrames{0};
+        std::atomic<uint32_t> latency{0};
+
+        std::optional<pros::Task> acquisitionTask;
+        std::optional<pros::Task> weightingTask;
+
+        /**
+         * @brief Take the latest frame out of the ring, skipping older frames.
+         *
+         * @return Whether there was a frame
+         */
+        bool takeLatest() {
+            if (!ring.pop(frame)) {
+                return false;
+            }
+
+            while (ring.pop(frame)) {
+                skippedFrames.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Take the latest frame and hand its odometry and sensor readings to the filter and motion model.
+         *
+         * @return Whether there was a frame
+         */
+        template<typename Filter, typename Model>
+        bool prepareUpdate(Filter &filter, Model &motionModel) {
+            if (!takeLatest()) {
+                return false;
+            }
+
+            // The first frame only sets the starting point of the odometry
+            const bool first = !started.load(std::memory_order_relaxed);
+            motionModel.setDisplacement((first ? 0.0f : frame.distance - lastDistance) * metre);
+
+            lastDistance = frame.distance;
+            rotation.store(frame.rotation, std::memory_order_relaxed);
+            started.store(true, std::memory_order_release);
+
+            const size_t sensorCount = std::min(filter.getSensors().size(), MaxSensors);
+            filter.useReadings(std::span<const SensorReading>(frame.readings).first(sensorCount));
+
+            return true;
+        }
+
+    public:
+        /**
+         * @param odometry Function returning the total distance travelled by the tracking center of the robot, for
+         * example the average of the two sides of a tank drive. Called in the acquisition task.
+         * @param rotation Function returning the rotation of the IMU in the loco coordinate system, for example
+         * -imu.get_rotation() * degree. Called in the acquisition task.
+         */
+        LocalizationPipeline(std::function<QLength()> odometry, std::function<Angle()> rotation)
+            : odometry(std::move(odometry)),
+              imuRotation(std::move(rotation)) {
+        }
+
+        LocalizationPipeline(const LocalizationPipeline &) = delete;
+        LocalizationPipeline &operator=(const LocalizationPipeline &) = delete;
+
+        /**
+         * @brief Angle function for the particle filter, returning the heading of the frame being processed. Also
+         * works as the IMU rotation of a HeadingEstimator. Before the first frame, such as when the filter is
+         * initialized, it reads the IMU directly.
+         *
+         * @return Function returning the heading read with the current frame
+         */
+        std::function<Angle()> getRotation() {
+            return [this]() {
+                return started.load(std::memory_order_acquire)
+                           ? Angle(rotation.load(std::memory_order_relaxed))
+                           : imuRotation();
+            };
+        }
+
+        /**
+         * @brief Read the odometry, the IMU and every sensor into a frame and push it into the ring. Called by the
+         * acquisition task, or by a loop of the user's own.
+         *
+         * @param filter Particle filter whose sensors are read
+         * @return Whether the frame was pushed, false if the ring was full and it was dropped
+         */
+        template<typename Filter>
+        bool acquire(Filter &filter) {
+            SensorFrame<MaxSensors> acquired;
+
+            acquired.timestamp = pros::micros();
+            acquired.distance = odometry().getValue();
+            acquired.rotation = imuRotation().getValue();
+
+            filter.getSensors().acquire(acquired.readings);
+
+            if (!ring.push(acquired)) {
+                droppedFrames.fetch_add(1, std::memory_order_relaxed);
+
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Update the particle filter with the latest frame in the ring, skipping older frames. The odometry is a
+         * running total, so the movement of skipped frames isn't lost.
+         *
+         * @param filter Particle filter to update
+         * @param motionModel Motion model given the distance travelled since the last processed frame
+         * @return Whether there was a frame to process
+         */
+        template<typename Filter, typename Model>
+        bool process(Filter &filter, Model &motionModel) {
+            if (!prepareUpdate(filter, motionModel)) {
+                return false;
+            }
+
+            filter.update(motionModel);
+
+            latency.store(static_cast<uint32_t>(pros::micros() - frame.timestamp), std::memory_order_relaxed);
+
+            return true;
+        }
+
+        /**
+         * @brief Update the particle filter with the latest frame in the ring, within a time budget, see
+         * BasicParticleFilter::update(MotionModel &, QTime).
+         *
+         * @param filter Particle filter to update
+         * @param motionModel Motion model given the distance travelled since the last processed frame
+         * @param budget Time the update is allowed to take
+         * @return How much the update was degraded, empty if there was no frame to process
+         */
+        template<typename Filter, typename Model>
+        std::optional<DeadlineReport> process(Filter &filter, Model &motionModel, const QTime budget) {
+            if (!prepareUpdate(filter, motionModel)) {
+                return std::nullopt;
+            }
+
+            const DeadlineReport report = filter.update(motionModel, budget);
+
+            latency.store(static_cast<uint32_t>(pros::micros() - frame.timestamp), std::memory_order_relaxed);
+
+            return report;
+        }
+
+        /**
+         * @brief Start the acquisition and weighting tasks. The acquisition task reads a frame every period and wakes
+         * the weighting task, which processes the latest frame and then waits for the next one.
+         *
+         * @param filter Particle filter to update, must outlive the pipeline
+         * @param motionModel Motion model used for the updates, must outlive the pipeline
+         * @param period Time between frames read by the acquisition task
+         * @param priority Priority of the acquisition task, above the weighting task and the drive control
+         */
+        template<typename Filter, typename Model>
+        void start(Filter &filter, Model &motionModel, const QTime period = 10_ms,
+                   const uint32_t priority = TASK_PRIORITY_MAX - 2) {
+            weightingTask.emplace([this, &filter, &motionModel]() {
+                while (true) {
+                    pros::Task::notify_take(true, TIMEOUT_MAX);
+
+                    process(filter, motionModel);
+                }
+            }, TASK_PRIORITY_DEFAULT, TASK_STACK_DEPTH_DEFAULT, "loco weighting");
+
+            const auto periodMs = static_cast<uint32_t>(std::max(period.Convert(millisecond), 1.0f));
+
+            acquisitionTask.emplace([this, &filter, periodMs]() {
+                uint32_t time = pros::millis();
+
+                while (true) {
+                    if (acquire(filter)) {
+                        weightingTask->notify();
+                    }
+
+                    pros::c::task_delay_until(&time, periodMs);
+                }
+            }, priority, TASK_STACK_DEPTH_DEFAULT, "loco acquisition");
+        }
+
+        /**
+         * @return Number of frames dropped because the ring was full
+         */
+        [[nodiscard]] uint32_t getDroppedFrames() const {
+            return droppedFrames.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @return Number of frames skipped because a newer frame was ready
+         */
+        [[nodiscard]] uint32_t getSkippedFrames() const {
+            return skippedFrames.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @return Time from reading the last processed frame to the end of its update in microseconds
+         */
+        [[nodiscard]] uint32_t getLatency() const {
+            return latency.load(std::memory_order_relaxed);
+        }
+    };
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "config.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace loco {
+    /**
+     * @brief Phases of a particle filter update that are timed by a profiler.
+     */
+    enum class Phase : size_t {
+        /**
+         * Moving the particles with the motion model or prediction function
+         */
+        Prediction,
+        /**
+         * SensorModel::update and SensorModel::prepare of every sensor
+         */
+        SensorUpdate,
+        /**
+         * Replacing particles outside the field and weighting every particle with the sensors
+         */
+        Likelihood,
+        /**
+         * Summing and normalizing the weights and computing the effective sample size
+         */
+        Normalization,
+        /**
+         * Resampling, including the particle count adaptation
+         */
+        Resampling,
+        /**
+         * Computing and publishing the mean and covariance
+         */
+        Estimate,
+        /**
+         * The whole update, from the start of the prediction to the end of the correction
+         */
+        Frame,
+        COUNT
+    };
+
+    /**
+     * @brief Rolling statistics of a timed phase, in microseconds.
+     */
+    struct PhaseStatistics {
+        uint32_t min = 0;
+        uint32_t mean = 0;
+        uint32_t max = 0;
+        uint32_t last = 0;
+
+        /**
+         * @brief Number of samples the statistics are computed over, at most the profiler's window.
+         */
+        size_t samples = 0;
+    };
+
+    /**
+     * @brief Profiler that records nothing, the default for the particle filters. Every call is empty and constant, so
+     * the instrumentation in the update is removed entirely by the compiler.
+     */
+    class NullProfiler {
+    public:
+        static constexpr uint32_t now() {
+            return 0;
+        }
+
+        constexpr void record(Phase, uint32_t) {
+        }
+
+        constexpr void recordSensor(size_t, uint32_t) {
+        }
+
+        constexpr void endFrame() {
+        }
+    };
+
+    /**
+     * @brief Profiler that times every phase of the particle filter update with pros::micros() and keeps rolling
+     * statistics over the last Window samples of each phase. Phases that are skipped in a frame, such as resampling
+     * when the effective sample size is still high, are not counted as zero.
+     *
+     * The statistics are updated by the task running the filter, read them from that task, for example after
+     * update() every few frames.
+     *
+     * @tparam MaxSensors Number of sensors whose likelihood evaluation is timed individually, extra sensors are ignored
+     * @tparam Window Number of samples the rolling statistics are computed over
+     */
+    template<size_t MaxSensors = 8, size_t Window = 64>
+    class FrameProfiler {
+    private:
+        struct Samples {
+            std::array<uint32_t, Window> values{};
+            size_t next = 0;
+            size_t size = 0;
+
+            void push(const uint32_t value) {
+                values[next] = value;
+                next = (next + 1) % Window;
+                size = std::min(size + 1, Window);
+            }
+
+            [[nodiscard]] PhaseStatistics statistics() const {
+                PhaseStatistics statistics;
+
+                if (size == 0) {
+                    return statistics;
+                }
+
+                uint64_t total = 0;
+                statistics.min = values[0];
+
+                for (size_t i = 0; i < size; i++) {
+                    statistics.min = std::min(statistics.min, values[i]);
+                    statistics.max = std::max(statistics.max, values[i]);
+                    total += values[i];
+                }
+
+                statistics.mean = static_cast<uint32_t>(total / size);
+                statistics.last = values[(next + Window - 1) % Window];
+                statistics.samples = size;
+
+                return statistics;
+            }
+        };
+
+        std::array<Samples, static_cast<size_t>(Phase::COUNT)> phases;
+        std::array<Samples, MaxSensors> sensors;
+
+        /**
+         * Likelihood time of each sensor in the current frame, the sensor sets time each block of particles separately
+         */
+        std::array<uint32_t, MaxSensors> frameSensorTime{};
+        std::array<bool, MaxSensors> frameSensorActive{};
+
+        uint32_t frameBudget = static_cast<uint32_t>(LOCO_CONFIG::FRAME_BUDGET.Convert(millisecond) * 1000.0f);
+
+        size_t frames = 0;
+        size_t overruns = 0;
+
+    public:
+        /**
+         * @return Current time in microseconds
+         */
+        static uint32_t now() {
+            return pros::micros();
+        }
+
+        /**
+         * @brief Record the time spent in a phase.
+         *
+         * @param phase Phase that just finished
+         * @param start Time the phase started, from now()
+         */
+        void record(const Phase phase, const uint32_t start) {
+            const uint32_t elapsed = now() - start;
+
+            phases[static_cast<size_t>(phase)].push(elapsed);
+
+            if (phase == Phase::Frame) {
+                frames++;
+
+                if (elapsed > frameBudget) {
+                    overruns++;
+                }
+            }
+        }
+
+        /**
+         * @brief Add time spent evaluating a sensor's likelihood to the current frame.
+         *
+         * @param sensor Index of the sensor in the sensor set
+         * @param start Time the evaluation started, from now()
+         */
+        void recordSensor(const size_t sensor, const uint32_t start) {
+            const uint32_t elapsed = now() - start;
+
+            if (sensor < MaxSensors) {
+                frameSensorTime[sensor] += elapsed;
+                frameSensorActive[sensor] = true;
+            }
+        }
+
+        /**
+         * @brief Finish the frame, adding the likelihood time of each sensor to its statistics.
+         */
+        void endFrame() {
+            for (size_t i = 0; i < MaxSensors; i++) {
+                if (frameSensorActive[i]) {
+                    sensors[i].push(frameSensorTime[i]);
+                }
+            }
+
+            frameSensorTime.fill(0);
+            frameSensorActive.fill(false);
+        }
+
+        /**
+         * @param phase Phase of the update
+         * @return Rolling statistics of the phase
+         */
+        [[nodiscard]] PhaseStatistics getStatistics(const Phase phase) const {
+            return phases[static_cast<size_t>(phase)].statistics();
+        }
+
+        /**
+         * @param sensor Index of the sensor, in the order the sensors were added
+         * @return Rolling statistics of the sensor's likelihood evaluation, empty if the sensor isn't tracked
+         */
+        [[nodiscard]] PhaseStatistics getSensorStatistics(const size_t sensor) const {
+            if (sensor >= MaxSensors) {
+                return {};
+            }
+
+            return sensors[sensor].statistics();
+        }
+
+        /**
+         * @brief Set the time an update is allowed to take before it is counted as an overrun.
+         *
+         * @param budget Maximum time of an update
+         */
+        void setFrameBudget(const QTime budget) {
+            frameBudget = static_cast<uint32_t>(budget.Convert(millisecond) * 1000.0f);
+        }
+
+        /**
+         * @return Number of updates timed since the last reset
+         */
+        [[nodiscard]] size_t getFrames() const {
+            return frames;
+        }
+
+        /**
+         * @return Number of updates that took longer than the frame budget since the last reset
+         */
+        [[nodiscard]] size_t getOverruns() const {
+            return overruns;
+        }
+
+        /**
+         * @brief Clear the statistics and counters.
+         */
+        void reset() {
+            phases = {};
+            sensors = {};
+            frames = 0;
+            overruns = 0;
+        }
+    };
+}
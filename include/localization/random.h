@@ -0,0 +1,187 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+
+namespace loco {
+    /**
+     * @brief xoshiro128+ random number engine with four interleaved streams. Each step advances all four streams with
+     * the same operations, so bulk generation with fill() vectorizes, and the engine is much faster per draw than
+     * std::ranlux24_base. Streams are reproducible for a given seed, which makes log replays deterministic. Engines
+     * created without a seed each get their own, so the filter's and the motion model's engines aren't correlated.
+     *
+     * Satisfies UniformRandomBitGenerator, so it can be used with the standard library distributions as well.
+     */
+    class Xoshiro128Plus {
+    public:
+        using result_type = uint32_t;
+
+        /**
+         * @brief Seed of the first engine created without a seed, the ones after it count up from here.
+         */
+        static constexpr uint64_t DEFAULT_SEED = 0x5eed10c0;
+
+    private:
+        static constexpr size_t LANES = 4;
+
+        /**
+         * Number of engines created without a seed so far
+         */
+        static inline std::atomic<uint32_t> unseededEngines{0};
+
+        /**
+         * State word k of every stream is stored together in state[k], so a step is four lane-wise operations
+         */
+        std::array<std::array<uint32_t, LANES>, 4> state{};
+        std::array<uint32_t, LANES> buffer{};
+        size_t next = LANES;
+
+        static constexpr uint32_t rotl(const uint32_t x, const int k) {
+            return (x << k) | (x >> (32 - k));
+        }
+
+        static constexpr uint64_t splitMix64(uint64_t &x) {
+            uint64_t z = (x += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        void step(std::array<uint32_t, LANES> &out) {
+            for (size_t l = 0; l < LANES; l++) {
+                out[l] = state[0][l] + state[3][l];
+
+                const uint32_t t = state[1][l] << 9;
+
+                state[2][l] ^= state[0][l];
+                state[3][l] ^= state[1][l];
+                state[1][l] ^= state[2][l];
+                state[0][l] ^= state[3][l];
+
+                state[2][l] ^= t;
+
+                state[3][l] = rotl(state[3][l], 11);
+            }
+        }
+
+    public:
+        /**
+         * @brief Engine seeded with DEFAULT_SEED plus the number of engines created without a seed before it. The
+         * seeds only depend on the order the engines are created in, so a program creating them in the same order
+         * replays the same streams.
+         */
+        Xoshiro128Plus() : Xoshiro128Plus(DEFAULT_SEED + unseededEngines.fetch_add(1, std::memory_order_relaxed)) {
+        }
+
+        /**
+         * @param seed Any value, expanded into the full state with SplitMix64
+         */
+        explicit Xoshiro128Plus(const uint64_t seed) {
+            this->seed(seed);
+        }
+
+        /**
+         * @brief Reset the engine to the start of the streams for a seed.
+         *
+         * @param seed Any value, expanded into the full state with SplitMix64
+         */
+        void seed(uint64_t seed) {
+            for (auto &&word: state) {
+                for (auto &&lane: word) {
+                    lane = static_cast<uint32_t>(splitMix64(seed) >> 32);
+                }
+            }
+
+            next = LANES;
+        }
+
+        static constexpr result_type min() {
+            return std::numeric_limits<result_type>::min();
+        }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()() {
+            if (next == LANES) {
+                step(buffer);
+                next = 0;
+            }
+
+            return buffer[next++];
+        }
+
+        /**
+         * @brief Fill a buffer with uniformly distributed floats in [lo, hi).
+         *
+         * @param out Buffer to fill
+         * @param lo Lower bound
+         * @param hi Upper bound
+         */
+        void fill(std::span<float> out, const float lo, const float hi) {
+            // The top 24 bits are used since the low bits of xoshiro128+ are weaker, and a float only holds 24 bits
+            const float scale = (hi - lo) * (1.0f / 16777216.0f);
+
+            const size_t blocked = out.size() - out.size() % LANES;
+
+            for (size_t i = 0; i < blocked; i += LANES) {
+                std::array<uint32_t, LANES> bits;
+                step(bits);
+
+                for (size_t l = 0; l < LANES; l++) {
+                    out[i + l] = lo + static_cast<float>(bits[l] >> 8) * scale;
+                }
+            }
+
+            for (size_t i = blocked; i < out.size(); i++) {
+                out[i] = lo + static_cast<float>((*this)() >> 8) * scale;
+            }
+        }
+    };
+
+    /**
+     * @brief Draw a uniformly distributed index in [0, n). Engines producing full 32 bit values, like Xoshiro128Plus,
+     * use a multiply and shift instead of a division.
+     *
+     * @tparam Random Random number engine
+     * @param random Engine to draw from
+     * @param n Number of possible indices, must be greater than 0
+     * @return Index in [0, n)
+     */
+    template<typename Random>
+    uint32_t uniformIndex(Random &random, const size_t n) {
+        if constexpr (Random::min() == 0 && Random::max() == std::numeric_limits<uint32_t>::max()) {
+            return static_cast<uint32_t>((static_cast<uint64_t>(random()) * n) >> 32);
+        } else {
+            return std::uniform_int_distribution<uint32_t>(0, n - 1)(random);
+        }
+    }
+
+    /**
+     * @brief Fill a buffer with uniformly distributed floats in [lo, hi), using the engine's own bulk fill when it has
+     * one, like Xoshiro128Plus, and std::uniform_real_distribution otherwise.
+     *
+     * @tparam Random Random number engine
+     * @param random Engine to draw from
+     * @param out Buffer to fill
+     * @param lo Lower bound
+     * @param hi Upper bound
+     */
+    template<typename Random>
+    void fillUniform(Random &random, std::span<float> out, const float lo, const float hi) {
+        if constexpr (requires { random.fill(out, lo, hi); }) {
+            random.fill(out, lo, hi);
+        } else {
+            std::uniform_real_distribution distribution(lo, hi);
+
+            for (auto &&value: out) {
+                value = distribution(random);
+            }
+        }
+    }
+}
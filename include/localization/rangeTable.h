@@ -0,0 +1,156 @@
+#pragma once
+
+#include "units/units.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace loco {
+    /**
+     * @brief Table of the range a distance sensor is expected to read from every (x, y, ø) on the field, so a sensor
+     * model can replace its ray casting with a table lookup. Ranges are quantized to millimetres and stored as 16 bit
+     * integers, a 64x64x128 table takes 1MB.
+     *
+     * Positions are sampled on a grid covering the field including its edges, and headings are sampled evenly around
+     * the circle. Lookups interpolate bilinearly in position and linearly in heading, and since every particle in a
+     * frame shares the same heading, the heading is resolved once per frame with slice().
+     */
+    class RangeTable {
+    public:
+        /**
+         * @brief Ranges in a single direction, blended from the two nearest heading samples.
+         */
+        class Slice {
+        private:
+            const RangeTable *table = nullptr;
+            const uint16_t *lower = nullptr;
+            const uint16_t *upper = nullptr;
+            float blend = 0.0f;
+
+            friend class RangeTable;
+
+        public:
+            /**
+             * @brief Look up the expected range of a sensor at a position, in the direction of the slice.
+             *
+             * @param x x position of the sensor in metres, clamped to the field
+             * @param y y position of the sensor in metres, clamped to the field
+             * @return Expected range in metres
+             */
+            [[nodiscard]] float lookup(const float x, const float y) const {
+                const size_t bins = table->positionBins;
+                const auto last = static_cast<float>(bins - 1);
+
+                const float fx = std::clamp((x + table->halfSize) * table->inverseSpacing, 0.0f, last);
+                const float fy = std::clamp((y + table->halfSize) * table->inverseSpacing, 0.0f, last);
+
+                const size_t ix = std::min(static_cast<size_t>(fx), bins - 2);
+                const size_t iy = std::min(static_cast<size_t>(fy), bins - 2);
+
+                const float tx = fx - static_cast<float>(ix);
+                const float ty = fy - static_cast<float>(iy);
+
+                const size_t i = ix * bins + iy;
+
+                const auto bilinear = [&](const uint16_t *values) {
+                    const float bottom = values[i] + tx * (static_cast<float>(values[i + bins]) - values[i]);
+                    const float top = values[i + 1] + tx * (static_cast<float>(values[i + bins + 1]) - values[i + 1]);
+
+                    return bottom + ty * (top - bottom);
+                };
+
+                const float lowerRange = bilinear(lower);
+
+                return (lowerRange + blend * (bilinear(upper) - lowerRange)) * 0.001f;
+            }
+        };
+
+    private:
+        float halfSize;
+        size_t positionBins;
+        size_t angleBins;
+
+        float inverseSpacing;
+
+        /**
+         * Ranges in millimetres, indexed by [heading][x][y] so each heading is a contiguous slice
+         */
+        std::vector<uint16_t> ranges;
+
+    public:
+        /**
+         * @param half_size Distance from the center of the field to its edges
+         * @param position_bins Number of samples along each axis of the field, at least 2
+         * @param angle_bins Number of heading samples around the circle
+         */
+        RangeTable(const QLength half_size, const size_t position_bins, const size_t angle_bins)
+            : halfSize(half_size.getValue()),
+              positionBins(std::max<size_t>(position_bins, 2)),
+              angleBins(std::max<size_t>(angle_bins, 1)),
+              inverseSpacing(static_cast<float>(positionBins - 1) / (2.0f * halfSize)),
+              ranges(positionBins * positionBins * angleBins) {
+        }
+
+        /**
+         * @brief Fill the table, this should be called once in initialize() since it evaluates the range function for
+         * every entry.
+         *
+         * @param rangeFunction Expected range in metres for a sensor at (x, y) pointing in the direction ø
+         */
+        void build(const std::function<float(float x, float y, float angle)> &rangeFunction) {
+            const float spacing = 2.0f * halfSize / static_cast<float>(positionBins - 1);
+
+            for (size_t a = 0; a < angleBins; a++) {
+                const auto angle = static_cast<float>(2.0 * M_PI * static_cast<double>(a) / angleBins);
+
+                for (size_t ix = 0; ix < positionBins; ix++) {
+                    for (size_t iy = 0; iy < positionBins; iy++) {
+                        const float range = rangeFunction(static_cast<float>(ix) * spacing - halfSize,
+                                                          static_cast<float>(iy) * spacing - halfSize, angle);
+
+                        ranges[(a * positionBins + ix) * positionBins + iy] = static_cast<uint16_t>(std::clamp(
+                            std::round(range * 1000.0f), 0.0f,
+                            static_cast<float>(std::numeric_limits<uint16_t>::max())));
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Resolve the heading for a frame.
+         *
+         * @param angle Global heading of the sensor in radians
+         * @return Slice to look up ranges in that direction
+         */
+        [[nodiscard]] Slice slice(const float angle) const {
+            const auto turns = static_cast<float>(angle / (2.0 * M_PI));
+            const float position = (turns - std::floor(turns)) * static_cast<float>(angleBins);
+
+            const size_t lower = std::min(static_cast<size_t>(position), angleBins - 1);
+            const size_t upper = (lower + 1) % angleBins;
+
+            const size_t sliceSize = positionBins * positionBins;
+
+            Slice slice;
+            slice.table = this;
+            slice.lower = ranges.data() + lower * sliceSize;
+            slice.upper = ranges.data() + upper * sliceSize;
+            slice.blend = position - static_cast<float>(lower);
+
+            return slice;
+        }
+
+        /**
+         * @brief Number of bytes used by the table's entries, to check the table fits in the RAM budget.
+         *
+         * @return Size of the table in bytes
+         */
+        [[nodiscard]] size_t sizeBytes() const {
+            return ranges.size() * sizeof(uint16_t);
+        }
+    };
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "units/units.hpp"
+#include "config.h"
+#include "random.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+
+namespace loco {
+    /**
+     * @brief Walk the cumulative weights once, giving every target in the sorted targets the index of the particle whose
+     * cumulative weight range contains it. Shared by the resamplers that draw sorted targets.
+     *
+     * @param weights Particle weights
+     * @param targets Sorted positions in [0, total weight), one per output particle
+     * @param ancestors Index of the selected particle for each target
+     * @param j Index of the particle the walk starts at, updated to where the walk stopped
+     * @param cumulativeWeight Cumulative weight up to and including particle j, updated with j
+     */
+    inline void cumulativeWeightWalk(std::span<const float> weights, std::span<const double> targets,
+                                     std::span<uint32_t> ancestors, size_t &j, double &cumulativeWeight) {
+        for (size_t i = 0; i < targets.size(); i++) {
+            // Stop at the last particle so rounding in the cumulative weight can't run off the end
+            while (cumulativeWeight <= targets[i] && j + 1 < weights.size()) {
+                j++;
+                cumulativeWeight += weights[j];
+            }
+
+            ancestors[i] = static_cast<uint32_t>(j);
+        }
+    }
+
+    /**
+     * @brief Systematic resampling. A single random offset is drawn and the particles are selected at evenly spaced
+     * points along the cumulative weights. Cheapest of the sorted resamplers, with low variance.
+     */
+    class SystematicResampler {
+    public:
+        /**
+         * @brief Select the ancestor of each new particle, with probability proportional to the weights.
+         *
+         * @param weights Particle weights
+         * @param totalWeight Sum of the weights
+         * @param ancestors Output index of the particle each new particle is copied from, can be longer than weights
+         * @param random Random number engine
+         */
+        template<typename Random>
+        void resample(std::span<const float> weights, const double totalWeight, std::span<uint32_t> ancestors,
+                      Random &random) {
+            const double step = totalWeight / static_cast<double>(ancestors.size());
+            const double offset = std::uniform_real_distribution(0.0, step)(random);
+
+            std::array<double, 64> targets;
+
+            size_t j = 0;
+            double cumulativeWeight = weights[0];
+
+            for (size_t start = 0; start < ancestors.size(); start += targets.size()) {
+                const size_t n = std::min(targets.size(), ancestors.size() - start);
+
+                for (size_t i = 0; i < n; i++) {
+                    targets[i] = static_cast<double>(start + i) * step + offset;
+                }
+
+                cumulativeWeightWalk(weights, std::span(targets).first(n), ancestors.subspan(start, n), j,
+                                     cumulativeWeight);
+            }
+        }
+    };
+
+    /**
+     * @brief Stratified resampling. The cumulative weights are split into equal strata and one point is drawn uniformly
+     * within each. Slightly more random draws than systematic resampling, but the strata are independent.
+     */
+    class StratifiedResampler {
+    public:
+        /**
+         * @brief Select the ancestor of each new particle, with probability proportional to the weights.
+         *
+         * @param weights Particle weights
+         * @param totalWeight Sum of the weights
+         * @param ancestors Output index of the particle each new particle is copied from, can be longer than weights
+         * @param random Random number engine
+         */
+        template<typename Random>
+        void resample(std::span<const float> weights, const double totalWeight, std::span<uint32_t> ancestors,
+                      Random &random) {
+            const double step = totalWeight / static_cast<double>(ancestors.size());
+
+            std::array<float, 64> offsets;
+            std::array<double, 64> targets;
+
+            size_t j = 0;
+            double cumulativeWeight = weights[0];
+
+            for (size_t start = 0; start < ancestors.size(); start += targets.size()) {
+                const size_t n = std::min(targets.size(), ancestors.size() - start);
+
+                fillUniform(random, std::span(offsets).first(n), 0.0f, 1.0f);
+
+                for (size_t i = 0; i < n; i++) {
+                    targets[i] = (static_cast<double>(start + i) + offsets[i]) * step;
+                }
+
+                cumulativeWeightWalk(weights, std::span(targets).first(n), ancestors.subspan(start, n), j,
+                                     cumulativeWeight);
+            }
+        }
+    };
+
+    /**
+     * @brief Residual resampling. Each particle is first copied floor(n * w / W) times deterministically, and the
+     * remaining particles are drawn systematically from the leftover weights. Lowest variance of the included
+     * resamplers, since most of the particles are chosen without any randomness.
+     */
+    class ResidualResampler {
+    public:
+        /**
+         * @brief Select the ancestor of each new particle, with probability proportional to the weights.
+         *
+         * @param weights Particle weights
+         * @param totalWeight Sum of the weights
+         * @param ancestors Output index of the particle each new particle is copied from, can be longer than weights
+         * @param random Random number engine
+         */
+        template<typename Random>
+        void resample(std::span<const float> weights, const double totalWeight, std::span<uint32_t> ancestors,
+                      Random &random) {
+            const size_t n = ancestors.size();
+            const double scale = static_cast<double>(n) / totalWeight;
+
+            size_t filled = 0;
+            double residualTotal = 0.0;
+
+            for (size_t i = 0; i < weights.size() && filled < n; i++) {
+                const auto copies = std::min(static_cast<size_t>(weights[i] * scale), n - filled);
+
+                std::fill_n(ancestors.begin() + filled, copies, static_cast<uint32_t>(i));
+                filled += copies;
+
+                residualTotal += weights[i] * scale - static_cast<double>(copies);
+            }
+
+            const size_t remaining = n - filled;
+
+            if (remaining == 0) {
+                return;
+            }
+
+            // Systematic resampling over the residuals, computed on the fly as n * w / W - floor(n * w / W)
+            const double step = residualTotal / static_cast<double>(remaining);
+            double target = std::uniform_real_distribution(0.0, step)(random);
+
+            size_t j = 0;
+            const auto residual = [&](const size_t k) {
+                const double scaled = weights[k] * scale;
+                return scaled - std::floor(scaled);
+            };
+            double cumulativeWeight = residual(0);
+
+            for (size_t i = filled; i < n; i++, target += step) {
+                while (cumulativeWeight <= target && j + 1 < weights.size()) {
+                    j++;
+                    cumulativeWeight += residual(j);
+                }
+
+                ancestors[i] = static_cast<uint32_t>(j);
+            }
+        }
+    };
+
+    /**
+     * @brief Metropolis resampling. Each new particle runs a short Metropolis chain over the particle indices, accepting
+     * a move to a random particle with probability w_j / w_k. No prefix sum or total weight is needed, so every particle
+     * is independent and the loop parallelizes, at the cost of a small bias when the chains are short.
+     */
+    class MetropolisResampler {
+    private:
+        size_t iterations;
+
+    public:
+        /**
+         * @param iterations Length of each Metropolis chain, longer chains reduce the bias when the weights are uneven
+         */
+        explicit MetropolisResampler(const size_t iterations = LOCO_CONFIG::METROPOLIS_ITERATIONS)
+            : iterations(iterations) {
+        }
+
+        /**
+         * @brief Select the ancestor of each new particle, with probability approximately proportional to the weights.
+         *
+         * @param weights Particle weights
+         * @param totalWeight Unused, Metropolis resampling only compares weights against each other
+         * @param ancestors Output index of the particle each new particle is copied from, can be longer than weights
+         * @param random Random number engine
+         */
+        template<typename Random>
+        void resample(std::span<const float> weights, [[maybe_unused]] const double totalWeight,
+                      std::span<uint32_t> ancestors, Random &random) {
+            std::array<float, 64> acceptance;
+
+            for (size_t i = 0; i < ancestors.size(); i++) {
+                auto k = static_cast<uint32_t>(i % weights.size());
+
+                for (size_t b = 0; b < iterations; b += acceptance.size()) {
+                    const size_t n = std::min(acceptance.size(), iterations - b);
+
+                    fillUniform(random, std::span(acceptance).first(n), 0.0f, 1.0f);
+
+                    for (size_t m = 0; m < n; m++) {
+                        const auto j = uniformIndex(random, weights.size());
+
+                        if (acceptance[m] * weights[k] <= weights[j]) {
+                            k = j;
+                        }
+                    }
+                }
+
+                ancestors[i] = k;
+            }
+        }
+    };
+}
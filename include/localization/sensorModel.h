@@ -1,6 +1,69 @@
 #pragma once
 
+#include "Eigen/Eigen"
+#include "units/units.hpp"
+#include "config.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+
 namespace loco {
+    /**
+     * @brief Raw values read from a sensor's device by SensorModel::acquire(), so the device can be read in a different
+     * task than the one weighting the particles. What each value holds is up to the sensor model.
+     */
+    struct SensorReading {
+        /**
+         * @brief Whether the sensor model filled in the reading. Sensor models that don't support acquire() leave it
+         * empty and read their device in update() instead.
+         */
+        bool acquired = false;
+
+        /**
+         * @brief Whether the device was installed when it was read.
+         */
+        bool installed = true;
+
+        /**
+         * @brief Values read from the device, in the order the sensor model reads them.
+         */
+        std::array<double, 4> values{};
+    };
+
+    /**
+     * @brief Tells a new sample from the previous sample read again, for sensors whose device reports no timestamp or
+     * sequence number. A reading that differs from the previous one is a new sample. An identical reading is usually
+     * the previous sample, but a sensor on a robot that stands still, or one driving parallel to a wall, reads identical
+     * new samples too. So after LOCO_CONFIG::SENSOR_MAX_STALE_FRAMES identical readings in a row the next one counts
+     * as new, and such a sensor is used at least that often.
+     */
+    class SampleTracker {
+    private:
+        size_t staleFrames = 0;
+
+    public:
+        /**
+         * @param changed Whether the reading differs from the previous one
+         * @return Whether the reading is treated as a new sample
+         */
+        bool update(const bool changed) {
+            if (changed || staleFrames >= LOCO_CONFIG::SENSOR_MAX_STALE_FRAMES) {
+                staleFrames = 0;
+
+                return true;
+            }
+
+            staleFrames++;
+
+            return false;
+        }
+    };
+
     /**
      * @brief Defiens a SensorModel to be used in the \refitem ParticleFilter. This is used in the update step to revise the filter's belief.
      */
@@ -14,11 +77,166 @@ namespace loco {
          */
         virtual std::optional<double> p(const Eigen::Vector3f &x) = 0;
 
+        /**
+         * @brief Multiply p(z_k, x_k) into the weights of a batch of particles that share the same heading. Particles are
+         * passed as a structure of arrays so sensor models can override this with a vectorized kernel, the default falls
+         * back to calling p(x) for each particle.
+         *
+         * Particles where p(x) has no value or isn't finite are left unchanged, matching the behaviour of the scalar path.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle, same length as x
+         * @param theta Heading shared by every particle in the batch
+         * @param weights Weight of each particle, same length as x, each is multiplied by the result of p(z_k, x_k)
+         */
+        virtual void pBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                            std::span<float> weights) {
+            for (size_t i = 0; i < weights.size(); i++) {
+                if (const auto weight = p(Eigen::Vector3f(x[i], y[i], theta));
+                    weight.has_value() && std::isfinite(weight.value())) {
+                    weights[i] *= static_cast<float>(weight.value());
+                }
+            }
+        }
+
+        /**
+         * @brief Add log p(z_k, x_k) to the log weights of a batch of particles that share the same heading. The particle
+         * filter accumulates likelihoods as logs, so the product of several sensors can't underflow to 0. The default
+         * runs pBatch on blocks of ones and takes the log of the result, override it when the log likelihood can be
+         * computed directly.
+         *
+         * Particles where p(x) has no value or isn't finite are left unchanged, matching pBatch.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle, same length as x
+         * @param theta Heading shared by every particle in the batch
+         * @param logWeights Log weight of each particle, same length as x, each has log p(z_k, x_k) added to it
+         */
+        virtual void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                               std::span<float> logWeights) {
+            constexpr size_t BLOCK_SIZE = 64;
+
+            alignas(16) std::array<float, BLOCK_SIZE> block;
+
+            for (size_t start = 0; start < logWeights.size(); start += BLOCK_SIZE) {
+                const size_t n = std::min(BLOCK_SIZE, logWeights.size() - start);
+
+                std::fill_n(block.begin(), n, 1.0f);
+
+                pBatch(x.subspan(start, n), y.subspan(start, n), theta, std::span<float>(block).first(n));
+
+                // A likelihood that underflowed to 0 is clamped to the smallest float instead of becoming -infinity
+                Eigen::Map<Eigen::ArrayXf>(logWeights.data() + start, static_cast<Eigen::Index>(n)) +=
+                        Eigen::Map<Eigen::ArrayXf>(block.data(), static_cast<Eigen::Index>(n))
+                        .max(std::numeric_limits<float>::min()).log();
+            }
+        }
+
+        /**
+         * @brief Multiply p(z_k, x_k) into the weights of a batch of particles that each have their own heading, for
+         * filters with per-particle headings. The default calls p(x) for each particle, sensor models that depend on
+         * the heading should override it with a kernel that computes the sine and cosine of each heading with
+         * fast_sin_cos.
+         *
+         * Particles where p(x) has no value or isn't finite are left unchanged, matching pBatch.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle, same length as x
+         * @param theta Heading of each particle, same length as x
+         * @param weights Weight of each particle, same length as x, each is multiplied by the result of p(z_k, x_k)
+         */
+        virtual void pBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                                std::span<float> weights) {
+            for (size_t i = 0; i < weights.size(); i++) {
+                if (const auto weight = p(Eigen::Vector3f(x[i], y[i], theta[i]));
+                    weight.has_value() && std::isfinite(weight.value())) {
+                    weights[i] *= static_cast<float>(weight.value());
+                }
+            }
+        }
+
+        /**
+         * @brief Add log p(z_k, x_k) to the log weights of a batch of particles that each have their own heading. The
+         * default runs pBatchPose on blocks of ones and takes the log of the result, like logPBatch.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle, same length as x
+         * @param theta Heading of each particle, same length as x
+         * @param logWeights Log weight of each particle, same length as x, each has log p(z_k, x_k) added to it
+         */
+        virtual void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                                   std::span<float> logWeights) {
+            constexpr size_t BLOCK_SIZE = 64;
+
+            alignas(16) std::array<float, BLOCK_SIZE> block;
+
+            for (size_t start = 0; start < logWeights.size(); start += BLOCK_SIZE) {
+                const size_t n = std::min(BLOCK_SIZE, logWeights.size() - start);
+
+                std::fill_n(block.begin(), n, 1.0f);
+
+                pBatchPose(x.subspan(start, n), y.subspan(start, n), theta.subspan(start, n),
+                           std::span<float>(block).first(n));
+
+                Eigen::Map<Eigen::ArrayXf>(logWeights.data() + start, static_cast<Eigen::Index>(n)) +=
+                        Eigen::Map<Eigen::ArrayXf>(block.data(), static_cast<Eigen::Index>(n))
+                        .max(std::numeric_limits<float>::min()).log();
+            }
+        }
+
+        /**
+         * @brief Prepare for weighting particles that all share the heading theta. Called once per frame after update()
+         * and before any p(x) or pBatch call, so work that only depends on the heading, such as rotating the sensor
+         * offset, is done once instead of once per particle. Filters with per-particle headings don't call it. The
+         * default does nothing.
+         *
+         * @param theta Heading shared by every particle this frame
+         */
+        virtual void prepare(const float theta) {
+        }
+
         /**
          * @brief Update object with sensor readings, this function is called every frame (~10ms) and should be used to stash expensive, one time computations before all the particles are calculated, this always runs before p(x) each frame.
          */
         virtual void update() = 0;
 
+        /**
+         * @brief Read the sensor's device without changing the sensor model, so it can run in another task while the
+         * particles are being weighted. The reading is processed later by apply(), in the task running the filter. The
+         * default returns an empty reading, so the device is read by update() in apply() instead.
+         *
+         * @return Raw reading of the device
+         */
+        [[nodiscard]] virtual SensorReading acquire() {
+            return {};
+        }
+
+        /**
+         * @brief Update the sensor model from a reading taken by acquire(), in place of update(). Sensor models that
+         * override acquire() implement update() as apply(acquire()). The default calls update().
+         *
+         * @param reading Reading returned by acquire()
+         */
+        virtual void apply(const SensorReading &reading) {
+            update();
+        }
+
+        /**
+         * @brief Whether the reading from the last update() is a new sample from the sensor. Sensors like the distance
+         * sensor and GPS refresh slower than the filter runs, and multiplying the same reading into the weights every
+         * frame would overweight it, so the filter skips sensors without a new sample. Neither device reports a
+         * sequence number, so those models compare readings with a SampleTracker, which can't tell an identical new
+         * sample from an old one until LOCO_CONFIG::SENSOR_MAX_STALE_FRAMES have passed. A sensor model that leaves
+         * a new sample out, such as a distance sensor blocked by a small object, reports it as not new. The filter
+         * compares the average likelihood of frames scored by the same sensors, and a sensor counted without scoring
+         * would make the next frame it scores look like the filter is lost. The default always reports a new sample.
+         *
+         * @return Whether the sensor has a new sample since the previous update() that it will score
+         */
+        [[nodiscard]] virtual bool isFresh() const {
+            return true;
+        }
+
         virtual ~SensorModel() = default;
     };
 }
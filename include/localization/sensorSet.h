@@ -0,0 +1,542 @@
+#pragma once
+
+#include "sensorModel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace loco {
+    /**
+     * @brief Number of frames a sensor had a new sample in, how many it was skipped in because its reading was stale or
+     * couldn't be scored, and how many of its new samples were skipped to fit an update in its time budget.
+     */
+    struct SensorFreshness {
+        size_t fresh = 0;
+        size_t stale = 0;
+        size_t skipped = 0;
+    };
+
+    /**
+     * @brief Sensors added at runtime through \refitem BasicParticleFilter::addSensor, reached through virtual calls.
+     * This is the default sensor set of the particle filters.
+     */
+    class DynamicSensorSet {
+    private:
+        std::vector<SensorModel *> sensors;
+        std::vector<bool> fresh;
+        std::vector<SensorFreshness> freshness;
+
+    public:
+        /**
+         * @brief Add a sensor, it is used from the next update onwards.
+         *
+         * @param sensor Sensor model, must outlive the particle filter
+         */
+        void add(SensorModel *sensor) {
+            sensors.emplace_back(sensor);
+            fresh.emplace_back(false);
+            freshness.emplace_back();
+        }
+
+        /**
+         * @brief Update every sensor with its latest reading, and check which sensors have a new sample.
+         *
+         * @return Whether any sensor has a new sample
+         */
+        bool update() {
+            bool anyFresh = false;
+
+            for (size_t i = 0; i < sensors.size(); i++) {
+                sensors[i]->update();
+
+                fresh[i] = sensors[i]->isFresh();
+                anyFresh |= fresh[i];
+
+                fresh[i] ? freshness[i].fresh++ : freshness[i].stale++;
+            }
+
+            return anyFresh;
+        }
+
+        /**
+         * @brief Read the device of every sensor without changing the sensor models, see SensorModel::acquire(). Safe
+         * to call from another task while the particles are weighted, as long as no sensor is added.
+         *
+         * @param readings Filled with the reading of each sensor, sensors past the end of readings aren't read
+         */
+        void acquire(std::span<SensorReading> readings) {
+            for (size_t i = 0; i < std::min(sensors.size(), readings.size()); i++) {
+                readings[i] = sensors[i]->acquire();
+            }
+        }
+
+        /**
+         * @brief Update every sensor from readings taken by acquire(), and check which sensors have a new sample.
+         * Sensors without a reading are updated with SensorModel::update().
+         *
+         * @param readings Reading of each sensor, in the order the sensors were added
+         * @return Whether any sensor has a new sample
+         */
+        bool apply(std::span<const SensorReading> readings) {
+            bool anyFresh = false;
+
+            for (size_t i = 0; i < sensors.size(); i++) {
+                i < readings.size() && readings[i].acquired ? sensors[i]->apply(readings[i]) : sensors[i]->update();
+
+                fresh[i] = sensors[i]->isFresh();
+                anyFresh |= fresh[i];
+
+                fresh[i] ? freshness[i].fresh++ : freshness[i].stale++;
+            }
+
+            return anyFresh;
+        }
+
+        /**
+         * @brief Prepare every sensor with a new sample for the heading shared by the particles this frame.
+         *
+         * @param theta Heading shared by every particle
+         */
+        void prepare(const float theta) {
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (fresh[i]) {
+                    sensors[i]->prepare(theta);
+                }
+            }
+        }
+
+        /**
+         * @param i Index of the sensor, in the order the sensors were added
+         * @return How often the sensor had a new sample
+         */
+        [[nodiscard]] SensorFreshness getFreshness(const size_t i) const {
+            return freshness[i];
+        }
+
+        /**
+         * @return Number of sensors
+         */
+        [[nodiscard]] size_t size() const {
+            return sensors.size();
+        }
+
+        /**
+         * @param i Index of the sensor, in the order the sensors were added
+         * @return Whether the sensor had a new sample in the last update()
+         */
+        [[nodiscard]] bool isFresh(const size_t i) const {
+            return fresh[i];
+        }
+
+        /**
+         * @brief Leave a sensor's new sample out of this frame, for example when there isn't time to evaluate it.
+         *
+         * @param i Index of the sensor, in the order the sensors were added
+         */
+        void skip(const size_t i) {
+            if (fresh[i]) {
+                fresh[i] = false;
+                freshness[i].skipped++;
+            }
+        }
+
+        /**
+         * @brief Multiply the likelihood of every sensor with a new sample into the weights of the particles.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param weights Weight of each particle
+         */
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta, std::span<float> weights) {
+            NullProfiler profiler;
+            pBatch(x, y, theta, weights, profiler);
+        }
+
+        /**
+         * @brief Multiply the likelihood of every sensor with a new sample into the weights of the particles, timing
+         * each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param weights Weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in
+         */
+        template<typename Profiler>
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta, std::span<float> weights,
+                    Profiler &profiler) {
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (!fresh[i]) {
+                    continue;
+                }
+
+                const uint32_t start = profiler.now();
+                sensors[i]->pBatch(x, y, theta, weights);
+                profiler.recordSensor(i, start);
+            }
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of the particles.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param logWeights Log weight of each particle
+         */
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights) {
+            NullProfiler profiler;
+            logPBatch(x, y, theta, logWeights, profiler);
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of the particles, timing
+         * each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param logWeights Log weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in
+         */
+        template<typename Profiler>
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights, Profiler &profiler) {
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (!fresh[i]) {
+                    continue;
+                }
+
+                const uint32_t start = profiler.now();
+                sensors[i]->logPBatch(x, y, theta, logWeights);
+                profiler.recordSensor(i, start);
+            }
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of particles that each
+         * have their own heading.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param logWeights Log weight of each particle
+         */
+        void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                           std::span<float> logWeights) {
+            NullProfiler profiler;
+            logPBatchPose(x, y, theta, logWeights, profiler);
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of particles that each
+         * have their own heading, timing each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param logWeights Log weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in
+         */
+        template<typename Profiler>
+        void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                           std::span<float> logWeights, Profiler &profiler) {
+            for (size_t i = 0; i < sensors.size(); i++) {
+                if (!fresh[i]) {
+                    continue;
+                }
+
+                const uint32_t start = profiler.now();
+                sensors[i]->logPBatchPose(x, y, theta, logWeights);
+                profiler.recordSensor(i, start);
+            }
+        }
+    };
+
+    /**
+     * @brief Sensors fixed at compile time and stored by value in a std::tuple. Since the type of every sensor is known,
+     * the calls to each sensor's pBatch are resolved statically and can be inlined. The particles are weighted in blocks
+     * small enough to stay in cache, running every sensor over a block before moving to the next one.
+     *
+     * @tparam Sensors Sensor model types, each deriving from SensorModel
+     */
+    template<typename... Sensors>
+    class StaticSensorSet {
+    private:
+        /**
+         * Number of particles weighted by every sensor before moving on to the next block
+         */
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        std::tuple<Sensors...> sensors;
+        std::array<bool, sizeof...(Sensors)> fresh{};
+        std::array<SensorFreshness, sizeof...(Sensors)> freshness{};
+
+    public:
+        explicit StaticSensorSet(Sensors... sensors)
+            : sensors(std::move(sensors)...) {
+        }
+
+        /**
+         * @brief Get one of the sensors, for example to read the GPS heading.
+         *
+         * @tparam I Index of the sensor in the template parameters
+         * @return Reference to the sensor
+         */
+        template<size_t I>
+        auto &get() {
+            return std::get<I>(sensors);
+        }
+
+        /**
+         * @brief Update every sensor with its latest reading, and check which sensors have a new sample.
+         *
+         * @return Whether any sensor has a new sample
+         */
+        bool update() {
+            std::apply([this](Sensors &... sensor) {
+                size_t i = 0;
+                ((sensor.Sensors::update(), fresh[i] = sensor.Sensors::isFresh(), i++), ...);
+            }, sensors);
+
+            bool anyFresh = false;
+
+            for (size_t i = 0; i < fresh.size(); i++) {
+                anyFresh |= fresh[i];
+
+                fresh[i] ? freshness[i].fresh++ : freshness[i].stale++;
+            }
+
+            return anyFresh;
+        }
+
+        /**
+         * @brief Read the device of every sensor without changing the sensor models, see SensorModel::acquire(). Safe
+         * to call from another task while the particles are weighted.
+         *
+         * @param readings Filled with the reading of each sensor, sensors past the end of readings aren't read
+         */
+        void acquire(std::span<SensorReading> readings) {
+            std::apply([readings](Sensors &... sensor) {
+                size_t i = 0;
+                ((i < readings.size() ? void(readings[i] = sensor.Sensors::acquire()) : void(), i++), ...);
+            }, sensors);
+        }
+
+        /**
+         * @brief Update every sensor from readings taken by acquire(), and check which sensors have a new sample.
+         * Sensors without a reading are updated with SensorModel::update().
+         *
+         * @param readings Reading of each sensor, in the order of the template parameters
+         * @return Whether any sensor has a new sample
+         */
+        bool apply(std::span<const SensorReading> readings) {
+            std::apply([this, readings](Sensors &... sensor) {
+                size_t i = 0;
+                ((i < readings.size() && readings[i].acquired
+                      ? sensor.Sensors::apply(readings[i])
+                      : sensor.Sensors::update(),
+                  fresh[i] = sensor.Sensors::isFresh(), i++), ...);
+            }, sensors);
+
+            bool anyFresh = false;
+
+            for (size_t i = 0; i < fresh.size(); i++) {
+                anyFresh |= fresh[i];
+
+                fresh[i] ? freshness[i].fresh++ : freshness[i].stale++;
+            }
+
+            return anyFresh;
+        }
+
+        /**
+         * @brief Prepare every sensor with a new sample for the heading shared by the particles this frame.
+         *
+         * @param theta Heading shared by every particle
+         */
+        void prepare(const float theta) {
+            std::apply([this, theta](Sensors &... sensor) {
+                size_t i = 0;
+                ((fresh[i++] ? sensor.Sensors::prepare(theta) : void()), ...);
+            }, sensors);
+        }
+
+        /**
+         * @param i Index of the sensor in the template parameters
+         * @return How often the sensor had a new sample
+         */
+        [[nodiscard]] SensorFreshness getFreshness(const size_t i) const {
+            return freshness[i];
+        }
+
+        /**
+         * @return Number of sensors
+         */
+        [[nodiscard]] static constexpr size_t size() {
+            return sizeof...(Sensors);
+        }
+
+        /**
+         * @param i Index of the sensor in the template parameters
+         * @return Whether the sensor had a new sample in the last update()
+         */
+        [[nodiscard]] bool isFresh(const size_t i) const {
+            return fresh[i];
+        }
+
+        /**
+         * @brief Leave a sensor's new sample out of this frame, for example when there isn't time to evaluate it.
+         *
+         * @param i Index of the sensor in the template parameters
+         */
+        void skip(const size_t i) {
+            if (fresh[i]) {
+                fresh[i] = false;
+                freshness[i].skipped++;
+            }
+        }
+
+        /**
+         * @brief Multiply the likelihood of every sensor with a new sample into the weights of the particles.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param weights Weight of each particle
+         */
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta, std::span<float> weights) {
+            NullProfiler profiler;
+            pBatch(x, y, theta, weights, profiler);
+        }
+
+        /**
+         * @brief Multiply the likelihood of every sensor with a new sample into the weights of the particles, timing
+         * each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param weights Weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in, summed over the blocks
+         */
+        template<typename Profiler>
+        void pBatch(std::span<const float> x, std::span<const float> y, const float theta, std::span<float> weights,
+                    Profiler &profiler) {
+            for (size_t start = 0; start < weights.size(); start += BLOCK_SIZE) {
+                const size_t n = std::min(BLOCK_SIZE, weights.size() - start);
+
+                std::apply([&](Sensors &... sensor) {
+                    size_t i = 0;
+                    uint32_t sensorStart;
+
+                    // Qualified calls skip the virtual dispatch, the exact type of each sensor is known here
+                    ((fresh[i]
+                          ? (sensorStart = profiler.now(),
+                             sensor.Sensors::pBatch(x.subspan(start, n), y.subspan(start, n), theta,
+                                                    weights.subspan(start, n)),
+                             profiler.recordSensor(i, sensorStart))
+                          : void(),
+                      i++), ...);
+                }, sensors);
+            }
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of the particles.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param logWeights Log weight of each particle
+         */
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights) {
+            NullProfiler profiler;
+            logPBatch(x, y, theta, logWeights, profiler);
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of the particles, timing
+         * each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading shared by every particle
+         * @param logWeights Log weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in, summed over the blocks
+         */
+        template<typename Profiler>
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights, Profiler &profiler) {
+            for (size_t start = 0; start < logWeights.size(); start += BLOCK_SIZE) {
+                const size_t n = std::min(BLOCK_SIZE, logWeights.size() - start);
+
+                std::apply([&](Sensors &... sensor) {
+                    size_t i = 0;
+                    uint32_t sensorStart;
+
+                    ((fresh[i]
+                          ? (sensorStart = profiler.now(),
+                             sensor.Sensors::logPBatch(x.subspan(start, n), y.subspan(start, n), theta,
+                                                       logWeights.subspan(start, n)),
+                             profiler.recordSensor(i, sensorStart))
+                          : void(),
+                      i++), ...);
+                }, sensors);
+            }
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of particles that each
+         * have their own heading.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param logWeights Log weight of each particle
+         */
+        void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                           std::span<float> logWeights) {
+            NullProfiler profiler;
+            logPBatchPose(x, y, theta, logWeights, profiler);
+        }
+
+        /**
+         * @brief Add the log likelihood of every sensor with a new sample to the log weights of particles that each
+         * have their own heading, timing each sensor.
+         *
+         * @param x x position of each particle
+         * @param y y position of each particle
+         * @param theta Heading of each particle
+         * @param logWeights Log weight of each particle
+         * @param profiler Profiler the time of each sensor is recorded in, summed over the blocks
+         */
+        template<typename Profiler>
+        void logPBatchPose(std::span<const float> x, std::span<const float> y, std::span<const float> theta,
+                           std::span<float> logWeights, Profiler &profiler) {
+            for (size_t start = 0; start < logWeights.size(); start += BLOCK_SIZE) {
+                const size_t n = std::min(BLOCK_SIZE, logWeights.size() - start);
+
+                std::apply([&](Sensors &... sensor) {
+                    size_t i = 0;
+                    uint32_t sensorStart;
+
+                    ((fresh[i]
+                          ? (sensorStart = profiler.now(),
+                             sensor.Sensors::logPBatchPose(x.subspan(start, n), y.subspan(start, n),
+                                                           theta.subspan(start, n), logWeights.subspan(start, n)),
+                             profiler.recordSensor(i, sensorStart))
+                          : void(),
+                      i++), ...);
+                }, sensors);
+            }
+        }
+    };
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Eigen/Eigen"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace loco {
+    /**
+     * @brief Single writer, multiple reader slot that never blocks. The writer fills the slot readers aren't looking at
+     * and then publishes it, so a reader only has to retry if the writer publishes twice while it is copying. This
+     * avoids the priority inversion of a plain seqlock, where a high priority reader can spin forever waiting on a
+     * preempted writer.
+     *
+     * The value is stored in relaxed atomic words, so concurrent reads and writes are well defined.
+     *
+     * @tparam T Trivially copyable value type
+     */
+    template<typename T>
+    class DoubleBufferedSlot {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+    private:
+        static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+        struct Buffer {
+            /**
+             * Odd while the writer is filling the buffer
+             */
+            std::atomic<uint32_t> sequence{0};
+            std::array<std::atomic<uint32_t>, WORDS> words{};
+        };
+
+        std::array<Buffer, 2> buffers{};
+        std::atomic<uint32_t> published{0};
+
+    public:
+        DoubleBufferedSlot() {
+            store(T{});
+        }
+
+        /**
+         * @brief Publish a new value. Must only be called from a single writer at a time.
+         *
+         * @param value Value to publish
+         */
+        void store(const T &value) {
+            const uint32_t index = published.load(std::memory_order_relaxed) ^ 1;
+            Buffer &buffer = buffers[index];
+
+            std::array<uint32_t, WORDS> words{};
+            std::memcpy(words.data(), &value, sizeof(T));
+
+            const uint32_t sequence = buffer.sequence.load(std::memory_order_relaxed);
+            buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t i = 0; i < WORDS; i++) {
+                buffer.words[i].store(words[i], std::memory_order_relaxed);
+            }
+
+            buffer.sequence.store(sequence + 2, std::memory_order_release);
+            published.store(index, std::memory_order_release);
+        }
+
+        /**
+         * @brief Read the latest published value. Safe to call from any number of tasks, never blocks the writer.
+         *
+         * @return Copy of the latest value
+         */
+        T load() const {
+            std::array<uint32_t, WORDS> words{};
+
+            while (true) {
+                const uint32_t index = published.load(std::memory_order_acquire);
+                const Buffer &buffer = buffers[index];
+
+                const uint32_t before = buffer.sequence.load(std::memory_order_acquire);
+
+                for (size_t i = 0; i < WORDS; i++) {
+                    words[i] = buffer.words[i].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // Retry if the writer lapped this reader and refilled the buffer while it was being copied, or the copy
+                // was of a newer value that hasn't been published yet
+                if (before % 2 == 0 && buffer.sequence.load(std::memory_order_relaxed) == before &&
+                    published.load(std::memory_order_relaxed) == index) {
+                    break;
+                }
+            }
+
+            T value;
+            std::memcpy(static_cast<void *>(&value), words.data(), sizeof(T));
+            return value;
+        }
+    };
+
+    /**
+     * @brief Consistent snapshot of the particle filter's estimate, published at the end of every update.
+     */
+    struct PoseSnapshot {
+        /**
+         * @brief Estimated [x, y, ø] of the robot, in metres and radians.
+         */
+        std::array<float, 3> pose{};
+
+        /**
+         * @brief Covariance of the particles, row major 3x3 over [x, y, ø].
+         */
+        std::array<float, 9> covariance{};
+
+        /**
+         * @brief Time of the update that produced the estimate, from pros::micros().
+         */
+        uint64_t timestamp = 0;
+
+        /**
+         * @brief Number of updates published before this one, useful to tell if the estimate has changed.
+         */
+        uint32_t sequence = 0;
+
+        [[nodiscard]] Eigen::Vector3f getPose() const {
+            return {pose[0], pose[1], pose[2]};
+        }
+
+        [[nodiscard]] Eigen::Matrix3f getCovariance() const {
+            return Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> >(covariance.data());
+        }
+    };
+}
@@ -1,5 +1,11 @@
 #pragma once
 
+#include "Eigen/Eigen"
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+
 namespace loco {
     /**
      * @brief Uses an inverse quintic to approximate the normal function. We use this to reduce the processing time for
@@ -19,4 +25,120 @@ namespace loco {
 
         return pdfApprox;
     }
+
+    /**
+     * @brief cheap_norm_pdf of a value given as its square, such as a squared Mahalanobis distance, which saves the
+     * square root since the approximation only uses x^4.
+     *
+     * @param x2 Squared number of standard deviations from mean
+     * @return Approximation of the normal pdf
+     */
+    inline float cheap_norm_pdf_squared(const float x2) {
+        return 0.3989422804014337f / (1.0f + 0.59422804014337f * x2 * x2);
+    }
+
+    /**
+     * @brief cheap_norm_pdf_squared evaluated on a packet of floats with Eigen's packet math.
+     *
+     * @tparam Packet Eigen packet type, such as Eigen::internal::packet_traits<float>::type
+     * @param x2 Squared number of standard deviations from mean in each lane
+     * @return Approximation of the normal pdf in each lane
+     */
+    template<typename Packet>
+    Packet cheap_norm_pdf_squared_packet(const Packet &x2) {
+        using namespace Eigen::internal;
+
+        return pdiv(pset1<Packet>(0.3989422804014337f),
+                    pmadd(pset1<Packet>(0.59422804014337f), pmul(x2, x2), pset1<Packet>(1.0f)));
+    }
+
+    /**
+     * @brief cheap_norm_pdf evaluated on a packet of floats with Eigen's packet math, so the same code uses NEON on the
+     * brain and SSE or AVX on a computer.
+     *
+     * @tparam Packet Eigen packet type, such as Eigen::internal::packet_traits<float>::type
+     * @param x Number of standard deviations from mean in each lane
+     * @return Approximation of the normal pdf in each lane
+     */
+    template<typename Packet>
+    Packet cheap_norm_pdf_packet(const Packet &x) {
+        return cheap_norm_pdf_squared_packet(Eigen::internal::pmul(x, x));
+    }
+
+    /**
+     * @brief Sine and cosine of an angle from a polynomial, for per-particle headings where calling std::sin and
+     * std::cos for every particle would cost more than the rest of the sensor model. The angle is reduced to
+     * [-π/4, π/4] around the nearest multiple of π/2, where minimax polynomials are accurate to ~1e-6, and the quadrant
+     * picks which of the two is the sine and their signs. Uses no branches or library calls, so the loops calling it
+     * can be vectorized.
+     *
+     * @param angle Angle in radians, accurate for angles up to 10^5 radians
+     * @param sine Set to the sine of the angle
+     * @param cosine Set to the cosine of the angle
+     */
+    inline void fast_sin_cos(const float angle, float &sine, float &cosine) {
+        // Adding 1.5 * 2^23 rounds to the nearest integer, which is left in the low bits of the float
+        const float shifted = angle * 0.636619772f + 12582912.0f;
+        const float quadrant = shifted - 12582912.0f;
+        const auto bits = std::bit_cast<int32_t>(shifted);
+
+        // π/2 is split in three floats, the first two with few enough bits that multiplying them by the quadrant is
+        // exact, so the remainder stays accurate for large angles
+        const float x = ((angle - quadrant * 1.5703125f) - quadrant * 4.83751297e-4f) - quadrant * 7.54978995e-8f;
+        const float x2 = x * x;
+
+        const float s = x + x * x2 * (-0.166628335f + x2 * 0.00815298629f);
+        const float c = 1.0f + x2 * (-0.499998948f + x2 * (0.0416562940f - x2 * 0.00135978155f));
+
+        // Odd quadrants swap the sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+        const bool swap = (bits & 1) != 0;
+
+        sine = (bits & 2) != 0 ? -(swap ? c : s) : swap ? c : s;
+        cosine = ((bits + 1) & 2) != 0 ? -(swap ? s : c) : swap ? s : c;
+    }
+
+    /**
+     * @brief fast_sin_cos evaluated on a packet of floats with Eigen's packet math.
+     *
+     * @tparam Packet Eigen packet type, such as Eigen::internal::packet_traits<float>::type
+     * @param angle Angle in radians in each lane
+     * @param sine Set to the sine of the angle in each lane
+     * @param cosine Set to the cosine of the angle in each lane
+     */
+    template<typename Packet>
+    void fast_sin_cos_packet(const Packet &angle, Packet &sine, Packet &cosine) {
+        using namespace Eigen::internal;
+        using IndexPacket = typename packet_traits<int32_t>::type;
+        constexpr size_t LANES = unpacket_traits<Packet>::size;
+
+        static_assert(unpacket_traits<IndexPacket>::size == LANES);
+
+        const Packet rounder = pset1<Packet>(12582912.0f);
+        const Packet shifted = pmadd(angle, pset1<Packet>(0.636619772f), rounder);
+        const Packet quadrant = psub(shifted, rounder);
+        const IndexPacket bits = preinterpret<IndexPacket>(shifted);
+
+        Packet x = pmadd(quadrant, pset1<Packet>(-1.5703125f), angle);
+        x = pmadd(quadrant, pset1<Packet>(-4.83751297e-4f), x);
+        x = pmadd(quadrant, pset1<Packet>(-7.54978995e-8f), x);
+        const Packet x2 = pmul(x, x);
+
+        const Packet s = pmadd(pmul(x, x2), pmadd(x2, pset1<Packet>(0.00815298629f), pset1<Packet>(-0.166628335f)), x);
+
+        Packet c = pmadd(x2, pset1<Packet>(-0.00135978155f), pset1<Packet>(0.0416562940f));
+        c = pmadd(x2, c, pset1<Packet>(-0.499998948f));
+        c = pmadd(x2, c, pset1<Packet>(1.0f));
+
+        const IndexPacket one = pset1<IndexPacket>(1);
+        const IndexPacket signBit = pset1<IndexPacket>(std::numeric_limits<int32_t>::min());
+
+        const Packet swap = preinterpret<Packet>(pcmp_eq(pand(bits, one), one));
+
+        // Bit 1 of the quadrant shifted into the sign bit flips the sign
+        const Packet sineSign = preinterpret<Packet>(pand(plogical_shift_left<30>(bits), signBit));
+        const Packet cosineSign = preinterpret<Packet>(pand(plogical_shift_left<30>(padd(bits, one)), signBit));
+
+        sine = pxor(pselect(swap, c, s), sineSign);
+        cosine = pxor(pselect(swap, s, c), cosineSign);
+    }
 }
@@ -25,8 +25,8 @@ loco::ParticleFilter<100> particleFilter([]() {
     return isfinite(angle.getValue()) ? angle : 0.0;
 });
 
-// Cheap random generator to add randomness to the drivetrain
-std::ranlux24_base de;
+// Motion model for the tank drive, it adds noise to the movement of every particle in a single pass
+loco::DifferentialDriveMotionModel driveModel(DRIVE_NOISE, ANGLE_NOISE);
 
 // Used to calculate the change in position on the drivetrain
 QLength lastLeft, lastRight;
@@ -110,22 +110,12 @@ void initialize() {
             // skid-steer based mechanics
             auto avg = (leftChange + rightChange) / 2.0;
 
-            // Define the distributions to add noise to the sensor readings
-            std::uniform_real_distribution avgDistribution(avg.getValue() - DRIVE_NOISE * avg.getValue(),
-                                                           avg.getValue() + DRIVE_NOISE * avg.getValue());
-            std::uniform_real_distribution angleDistribution(
-                particleFilter.getAngle().getValue() - ANGLE_NOISE.getValue(),
-                particleFilter.getAngle().getValue() + ANGLE_NOISE.getValue());
-
-            // Update the filter with the new data and noise from the sensors
-            particleFilter.update([&]() mutable {
-                // Calculate noisy sensor readings
-                const auto noisy = avgDistribution(de);
-                const auto angle = angleDistribution(de);
-
-                // Calculate the translation with the sensor readings
-                return Eigen::Rotation2Df(angle) * Eigen::Vector2f({noisy, 0.0});
-            });
+            // Give the motion model the movement of the drivetrain this frame
+            driveModel.setDisplacement(avg);
+
+            // Update the filter with the new data, the motion model adds the noise to each particle. The update is
+            // given 5ms of the 10ms frame, so it can't starve the other tasks when many sensors have new samples
+            particleFilter.update(driveModel, 5_ms);
 
             // Wait 10ms for the next frame, incorporating the wait
             pros::c::task_delay_until(&start_time, 10);
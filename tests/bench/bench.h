@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace loco::bench {
+    /**
+     * Results of the benchmarked work are added here, so the compiler can't remove the work
+     */
+    inline volatile double sink = 0.0;
+
+    /**
+     * @brief Time a piece of work.
+     *
+     * @param repeats Number of times to run the work
+     * @param work Function running the work once
+     * @return Average time of one run in nanoseconds
+     */
+    template<typename Work>
+    double timeNs(const size_t repeats, Work &&work) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < repeats; i++) {
+            work();
+        }
+
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        return elapsed.count() / static_cast<double>(repeats);
+    }
+}
@@ -0,0 +1,97 @@
+#include "main.h"
+#include "bench/bench.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Ray casting cost of FieldMap against testing every segment, for maps of the perimeter walls plus randomly placed
+// field elements, at several grid resolutions. The grid only tests the segments in the cells a ray passes through, so
+// its cost should stay close to flat as segments are added while the brute force cost grows with them. Every ray is
+// also checked against the brute force result.
+
+namespace {
+    constexpr size_t RAYS = 200'000;
+
+    float bruteForce(const std::vector<loco::FieldMap::Segment> &segments, const float x, const float y,
+                     const float dirX, const float dirY) {
+        float nearest = loco::FieldMap::MAX_RANGE;
+
+        for (const auto &[start, end]: segments) {
+            const float ex = end.x() - start.x(), ey = end.y() - start.y();
+            const float denominator = dirX * ey - dirY * ex;
+
+            if (std::abs(denominator) < 1e-9f) {
+                continue;
+            }
+
+            const float wx = start.x() - x, wy = start.y() - y;
+            const float t = (wx * ey - wy * ex) / denominator;
+            const float u = (wx * dirY - wy * dirX) / denominator;
+
+            if (t >= 0.0f && u >= 0.0f && u <= 1.0f) {
+                nearest = std::min(nearest, t);
+            }
+        }
+
+        return nearest;
+    }
+}
+
+int main() {
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-M_PI, M_PI), length(0.05f, 0.4f);
+
+    std::vector<float> x(RAYS), y(RAYS), dirX(RAYS), dirY(RAYS);
+
+    for (size_t i = 0; i < RAYS; i++) {
+        x[i] = position(generator);
+        y[i] = position(generator);
+
+        const float a = angle(generator);
+        dirX[i] = std::cos(a);
+        dirY[i] = std::sin(a);
+    }
+
+    std::printf("%10s %8s %12s %14s %12s\n", "segments", "cells", "grid ns/ray", "brute ns/ray", "mismatches");
+
+    for (const size_t elements: {0, 56, 200}) {
+        std::vector<loco::FieldMap::Segment> segments(loco::WALLS.begin(), loco::WALLS.end());
+
+        for (size_t i = 0; i < elements; i++) {
+            const float sx = position(generator), sy = position(generator);
+            const float a = angle(generator), l = length(generator);
+
+            segments.emplace_back(Eigen::Vector2f(sx, sy), Eigen::Vector2f(sx + l * std::cos(a), sy + l * std::sin(a)));
+        }
+
+        size_t i = 0;
+
+        const double bruteNs = loco::bench::timeNs(RAYS, [&]() {
+            loco::bench::sink = loco::bench::sink + bruteForce(segments, x[i], y[i], dirX[i], dirY[i]);
+            i++;
+        });
+
+        for (const size_t cells: {8, 16, 32}) {
+            const loco::FieldMap map(segments, 1.78308_m, cells);
+
+            i = 0;
+
+            const double gridNs = loco::bench::timeNs(RAYS, [&]() {
+                loco::bench::sink = loco::bench::sink + map.raycast(x[i], y[i], dirX[i], dirY[i]);
+                i++;
+            });
+
+            size_t mismatches = 0;
+
+            for (size_t k = 0; k < RAYS; k++) {
+                mismatches += std::abs(map.raycast(x[k], y[k], dirX[k], dirY[k]) -
+                                       bruteForce(segments, x[k], y[k], dirX[k], dirY[k])) > 1e-4f;
+            }
+
+            std::printf("%10zu %8zu %12.1f %14.1f %12zu\n", segments.size(), cells, gridNs, bruteNs, mismatches);
+        }
+    }
+
+    return 0;
+}
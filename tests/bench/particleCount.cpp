@@ -0,0 +1,61 @@
+#include "main.h"
+#include "bench/bench.h"
+#include "stubs/mockDevices.h"
+
+#include <array>
+#include <cstdio>
+
+// Cost of a full update per particle as the particle count grows, for a DynamicParticleFilter in a caller supplied
+// arena, with the fixed size ParticleFilter at 500 particles for comparison. Every frame has new readings from four
+// distance sensors and resamples, so each update runs the whole correction.
+
+namespace {
+    constexpr size_t FRAMES = 200;
+    constexpr size_t MAX_PARTICLES = 5000;
+
+    alignas(64) std::array<std::byte, loco::ArenaParticleStorage::requiredBytes(MAX_PARTICLES)> arena;
+
+    template<typename Filter>
+    double frameNs(Filter &filter) {
+        for (uint8_t port = 1; port <= 4; port++) {
+            const Eigen::Vector3f offset(0.1f, 0.0f, static_cast<float>((port - 1) * M_PI_2));
+            filter.addSensor(new loco::DistanceSensorModel(offset, pros::Distance(port)));
+        }
+
+        filter.initUniform(-1.7_m, -1.7_m, 1.7_m, 1.7_m);
+        filter.setResampleThreshold(1.0);
+
+        size_t frame = 0;
+
+        return loco::bench::timeNs(FRAMES, [&]() {
+            for (uint8_t port = 1; port <= 4; port++) {
+                loco::test::distanceDevices[port].distance = 600 + 100 * port + static_cast<std::int32_t>(frame % 7);
+            }
+
+            filter.update([]() { return Eigen::Vector2f(0.03f, 0.0f); });
+            loco::bench::sink = loco::bench::sink + filter.getPrediction().x();
+
+            frame++;
+        });
+    }
+}
+
+int main() {
+    std::printf("%10s %14s %16s\n", "particles", "us/frame", "ns/particle");
+
+    for (const size_t particles: {100, 250, 500, 1000, 2000, 5000}) {
+        loco::DynamicParticleFilter<> filter([]() { return Angle(0.3); }, std::span<std::byte>(arena), particles);
+
+        const double ns = frameNs(filter);
+
+        std::printf("%10zu %14.1f %16.1f\n", particles, ns / 1000.0, ns / static_cast<double>(particles));
+    }
+
+    static loco::ParticleFilter<500> fixed([]() { return Angle(0.3); });
+
+    const double ns = frameNs(fixed);
+
+    std::printf("%10s %14.1f %16.1f  (ParticleFilter<500>)\n", "500", ns / 1000.0, ns / 500.0);
+
+    return 0;
+}
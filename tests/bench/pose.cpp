@@ -0,0 +1,67 @@
+#include "main.h"
+#include "bench/bench.h"
+#include "stubs/mockDevices.h"
+
+#include <cstdio>
+
+// Cost of PoseParticleFilter, where every particle carries its own heading, against the 2-DOF ParticleFilter with the
+// same particles, sensors and motion model. Every frame has new readings from four distance sensors and resamples.
+// The pose filter pays for per-particle heading noise in the prediction and a per-lane sine and cosine in every sensor
+// kernel, the profiler splits the frame into those phases.
+
+namespace {
+    constexpr size_t PARTICLES = 2000;
+    constexpr size_t FRAMES = 400;
+
+    using Profiler = loco::FrameProfiler<4, FRAMES>;
+
+    loco::ParticleFilter<PARTICLES, loco::Xoshiro128Plus, loco::SystematicResampler, Profiler> planar(
+        []() { return Angle(0.4); });
+    loco::PoseParticleFilter<PARTICLES, loco::Xoshiro128Plus, loco::SystematicResampler, Profiler> pose(
+        []() { return Angle(0.4); });
+
+    template<typename Filter>
+    void run(Filter &filter, const char *name) {
+        for (uint8_t port = 1; port <= 4; port++) {
+            const Eigen::Vector3f offset(0.0f, 0.0f, static_cast<float>((port - 1) * M_PI_2));
+            filter.addSensor(new loco::DistanceSensorModel(offset, pros::Distance(port)));
+        }
+
+        loco::DifferentialDriveMotionModel model(0.1f, 2_deg);
+        model.setHeadingNoise(0.1_deg);
+
+        filter.initNormal({0.3f, -0.2f}, Eigen::Matrix2f::Identity() * 0.05f, false);
+        filter.setResampleThreshold(1.0);
+
+        size_t frame = 0;
+
+        const double ns = loco::bench::timeNs(FRAMES, [&]() {
+            for (uint8_t port = 1; port <= 4; port++) {
+                loco::test::distanceDevices[port].distance = 600 + 100 * port + static_cast<std::int32_t>(frame % 7);
+            }
+
+            model.setDisplacement(0.03_m);
+            filter.update(model);
+            loco::bench::sink = loco::bench::sink + filter.getPrediction().x();
+
+            frame++;
+        });
+
+        const Profiler &profiler = filter.getProfiler();
+
+        std::printf("%-8s %10.1f %12.1f %14u %14u %14u\n", name, ns / 1000.0, ns / PARTICLES,
+                    profiler.getStatistics(loco::Phase::Prediction).mean,
+                    profiler.getStatistics(loco::Phase::Likelihood).mean,
+                    profiler.getStatistics(loco::Phase::Resampling).mean);
+    }
+}
+
+int main() {
+    std::printf("%-8s %10s %12s %14s %14s %14s\n", "filter", "us/frame", "ns/particle", "prediction us",
+                "likelihood us", "resampling us");
+
+    run(planar, "2-DOF");
+    run(pose, "3-DOF");
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "main.h"
+#include "bench/bench.h"
+
+#include <cstdio>
+#include <vector>
+
+// Cost per particle of DistanceSensorModel with and without the per-frame prepare(). Before prepare() was part of the
+// sensor model contract, every particle rotated the sensor offset, picked the walls it faces and computed their
+// secants, which is what preparing again for every particle does. With prepare() that work is done once per frame,
+// and pBatch runs the remaining per-particle work a SIMD packet at a time.
+
+namespace {
+    constexpr size_t PARTICLES = 1000;
+    constexpr size_t FRAMES = 2000;
+}
+
+int main() {
+    loco::DistanceSensorModel sensor(Eigen::Vector3f(-0.1f, 0.15f, static_cast<float>(M_PI_2)), pros::Distance(1));
+    sensor.update();
+
+    std::vector<float> x(PARTICLES), y(PARTICLES), weights(PARTICLES, 1.0f);
+
+    for (size_t i = 0; i < PARTICLES; i++) {
+        x[i] = -1.5f + 3.0f * static_cast<float>(i) / PARTICLES;
+        y[i] = 1.2f - 2.0f * static_cast<float>(i * 7 % PARTICLES) / PARTICLES;
+    }
+
+    const auto frame = [](const size_t f) { return 0.01f * static_cast<float>(f); };
+    size_t f = 0;
+
+    const double perParticleNs = loco::bench::timeNs(FRAMES, [&]() {
+        const float theta = frame(f++);
+        double sum = 0.0;
+
+        for (size_t i = 0; i < PARTICLES; i++) {
+            sensor.prepare(theta);
+            sum += sensor.p(Eigen::Vector3f(x[i], y[i], theta)).value_or(0.0);
+        }
+
+        loco::bench::sink = loco::bench::sink + sum;
+    });
+
+    f = 0;
+
+    const double perFrameNs = loco::bench::timeNs(FRAMES, [&]() {
+        const float theta = frame(f++);
+        double sum = 0.0;
+
+        sensor.prepare(theta);
+
+        for (size_t i = 0; i < PARTICLES; i++) {
+            sum += sensor.p(Eigen::Vector3f(x[i], y[i], theta)).value_or(0.0);
+        }
+
+        loco::bench::sink = loco::bench::sink + sum;
+    });
+
+    f = 0;
+
+    const double batchNs = loco::bench::timeNs(FRAMES, [&]() {
+        const float theta = frame(f++);
+
+        std::fill(weights.begin(), weights.end(), 1.0f);
+
+        sensor.prepare(theta);
+        sensor.pBatch(x, y, theta, weights);
+
+        loco::bench::sink = loco::bench::sink + weights[0];
+    });
+
+    std::printf("%-40s %12s\n", "", "ns/particle");
+    std::printf("%-40s %12.1f\n", "p(), heading work per particle", perParticleNs / PARTICLES);
+    std::printf("%-40s %12.1f\n", "p(), prepare() once per frame", perFrameNs / PARTICLES);
+    std::printf("%-40s %12.1f\n", "pBatch(), prepare() once per frame", batchNs / PARTICLES);
+
+    return 0;
+}
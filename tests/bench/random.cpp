@@ -0,0 +1,51 @@
+#include "main.h"
+#include "bench/bench.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Uniform float draws per second of Xoshiro128Plus against std::ranlux24_base, the engine the filter used before. Bulk
+// draws go through fillUniform, the way the filter draws its random particles, and single draws through
+// std::uniform_real_distribution, the way the motion model draws its noise.
+
+namespace {
+    constexpr size_t BUFFER = 1000;
+    constexpr size_t REPEATS = 20'000;
+
+    template<typename Random>
+    void run(const char *name) {
+        Random random;
+        std::vector<float> buffer(BUFFER);
+
+        const double bulkNs = loco::bench::timeNs(REPEATS, [&]() {
+            loco::fillUniform(random, std::span<float>(buffer), -1.0f, 1.0f);
+            loco::bench::sink = loco::bench::sink + buffer[0];
+        });
+
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+        const double singleNs = loco::bench::timeNs(REPEATS, [&]() {
+            float sum = 0.0f;
+
+            for (size_t i = 0; i < BUFFER; i++) {
+                sum += distribution(random);
+            }
+
+            loco::bench::sink = loco::bench::sink + sum;
+        });
+
+        const auto perSecond = [](const double ns) { return 1e3 * static_cast<double>(BUFFER) / ns; };
+
+        std::printf("%-16s %14.1f %16.1f\n", name, perSecond(bulkNs), perSecond(singleNs));
+    }
+}
+
+int main() {
+    std::printf("%-16s %14s %16s\n", "engine", "bulk Mdraws/s", "single Mdraws/s");
+
+    run<loco::Xoshiro128Plus>("Xoshiro128Plus");
+    run<std::ranlux24_base>("ranlux24_base");
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "main.h"
+#include "bench/bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Accuracy and speed of RangeTable at several resolutions against the analytic ray cast to the walls. The error is
+// measured at random sensor poses on the field. It is largest where the nearest wall changes, such as near a corner,
+// where interpolating between samples blends the ranges to two different walls. The speed of DistanceSensorModel's
+// pBatch is then compared with and without a table.
+
+namespace {
+    constexpr size_t SAMPLES = 200'000;
+    constexpr size_t PARTICLES = 1000;
+    constexpr size_t FRAMES = 5000;
+
+    struct Pose {
+        float x, y, angle;
+    };
+
+    void accuracy(const std::vector<Pose> &poses) {
+        std::printf("%-14s %10s %10s %12s %12s %12s %14s\n", "resolution", "size KB", "build ms", "median mm",
+                    "p95 mm", "p99 mm", "ns/lookup");
+
+        for (const auto &[positionBins, angleBins]: {std::pair<size_t, size_t>{16, 64}, {32, 128}, {64, 128},
+                                                     {64, 256}, {128, 360}}) {
+            loco::RangeTable table(1.78308_m, positionBins, angleBins);
+
+            const double buildNs = loco::bench::timeNs(1, [&]() {
+                table.build(loco::DistanceSensorModel::rayToWalls);
+            });
+
+            std::vector<float> errors;
+            errors.reserve(poses.size());
+
+            for (const Pose &pose: poses) {
+                const float analytic = loco::DistanceSensorModel::rayToWalls(pose.x, pose.y, pose.angle);
+                errors.push_back(std::abs(table.slice(pose.angle).lookup(pose.x, pose.y) - analytic) * 1000.0f);
+            }
+
+            std::sort(errors.begin(), errors.end());
+
+            size_t i = 0;
+
+            const double lookupNs = loco::bench::timeNs(poses.size(), [&]() {
+                const Pose &pose = poses[i++];
+                loco::bench::sink = loco::bench::sink + table.slice(pose.angle).lookup(pose.x, pose.y);
+            });
+
+            char resolution[32];
+            std::snprintf(resolution, sizeof(resolution), "%zux%zux%zu", positionBins, positionBins, angleBins);
+
+            std::printf("%-14s %10.1f %10.1f %12.2f %12.2f %12.1f %14.1f\n", resolution,
+                        static_cast<double>(table.sizeBytes()) / 1024.0, buildNs / 1e6, errors[errors.size() / 2],
+                        errors[errors.size() * 95 / 100], errors[errors.size() * 99 / 100], lookupNs);
+        }
+    }
+
+    void speed() {
+        loco::RangeTable table(1.78308_m, 64, 128);
+        table.build(loco::DistanceSensorModel::rayToWalls);
+
+        loco::DistanceSensorModel sensor(Eigen::Vector3f(-0.1f, 0.15f, static_cast<float>(M_PI_2)), pros::Distance(1));
+        sensor.update();
+
+        std::vector<float> x(PARTICLES), y(PARTICLES), weights(PARTICLES);
+
+        for (size_t i = 0; i < PARTICLES; i++) {
+            x[i] = -1.5f + 3.0f * static_cast<float>(i) / PARTICLES;
+            y[i] = 1.2f - 2.0f * static_cast<float>(i * 7 % PARTICLES) / PARTICLES;
+        }
+
+        std::printf("\n%-24s %12s\n", "pBatch", "ns/particle");
+
+        for (const bool useTable: {false, true}) {
+            sensor.setRangeTable(useTable ? &table : nullptr);
+
+            size_t f = 0;
+
+            const double ns = loco::bench::timeNs(FRAMES, [&]() {
+                const float theta = 0.01f * static_cast<float>(f++);
+
+                std::fill(weights.begin(), weights.end(), 1.0f);
+
+                sensor.prepare(theta);
+                sensor.pBatch(x, y, theta, weights);
+
+                loco::bench::sink = loco::bench::sink + weights[0];
+            });
+
+            std::printf("%-24s %12.2f\n", useTable ? "64x64x128 table" : "analytic", ns / PARTICLES);
+        }
+    }
+}
+
+int main() {
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-M_PI, M_PI);
+
+    std::vector<Pose> poses(SAMPLES);
+
+    for (Pose &pose: poses) {
+        pose = {position(generator), position(generator), angle(generator)};
+    }
+
+    accuracy(poses);
+    speed();
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "main.h"
+#include "bench/bench.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Time per resample and quality of each resampler across particle counts. The weights are drawn from a heavy tailed
+// distribution, like the weights after a sensor update. Over many resamples, the number of copies of each particle
+// should average n * w / W (the bias is the largest deviation from that), and the lower its variance the less
+// information resampling throws away.
+
+namespace {
+    constexpr size_t REPEATS = 2000;
+
+    template<typename Resampler>
+    void run(const char *name) {
+        for (const size_t n: {100, 500, 1000, 5000}) {
+            Resampler resampler;
+            loco::Xoshiro128Plus random(7);
+
+            std::vector<float> weights(n);
+            std::exponential_distribution<float> distribution(1.0f);
+            double totalWeight = 0.0;
+
+            for (auto &weight: weights) {
+                weight = distribution(random) * distribution(random);
+                totalWeight += weight;
+            }
+
+            std::vector<uint32_t> ancestors(n);
+            std::vector<uint32_t> copies(n);
+            std::vector<double> copiesSum(n, 0.0), copiesSquaredSum(n, 0.0);
+
+            double resampleNs = 0.0;
+
+            for (size_t k = 0; k < REPEATS; k++) {
+                resampleNs += loco::bench::timeNs(1, [&]() {
+                    resampler.resample(weights, totalWeight, std::span<uint32_t>(ancestors), random);
+                });
+
+                std::fill(copies.begin(), copies.end(), 0);
+
+                for (const uint32_t ancestor: ancestors) {
+                    copies[ancestor]++;
+                }
+
+                for (size_t i = 0; i < n; i++) {
+                    copiesSum[i] += copies[i];
+                    copiesSquaredSum[i] += static_cast<double>(copies[i]) * copies[i];
+                }
+            }
+
+            double bias = 0.0, variance = 0.0;
+
+            for (size_t i = 0; i < n; i++) {
+                const double mean = copiesSum[i] / REPEATS;
+                const double expected = static_cast<double>(n) * weights[i] / totalWeight;
+
+                bias = std::max(bias, std::abs(mean - expected));
+                variance += copiesSquaredSum[i] / REPEATS - mean * mean;
+            }
+
+            std::printf("%-12s %6zu %14.2f %10.3f %14.4f\n", name, n, resampleNs / REPEATS / 1000.0, bias,
+                        variance / static_cast<double>(n));
+        }
+    }
+}
+
+int main() {
+    std::printf("%-12s %6s %14s %10s %14s\n", "resampler", "n", "us/resample", "max bias", "mean variance");
+
+    run<loco::SystematicResampler>("systematic");
+    run<loco::StratifiedResampler>("stratified");
+    run<loco::ResidualResampler>("residual");
+    run<loco::MetropolisResampler>("metropolis");
+
+    return 0;
+}
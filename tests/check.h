@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * Number of failed checks in the test, returned from main()
+ */
+inline int failures = 0;
+
+/**
+ * @brief Check a condition, printing it and counting a failure if it doesn't hold. The test keeps running so every
+ * failure in it is reported.
+ */
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);     \
+            failures++;                                                                   \
+        }                                                                                 \
+    } while (false)
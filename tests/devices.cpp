@@ -0,0 +1,195 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+#include "localization/likelihoodField.h"
+#include "localization/pipeline.h"
+
+// Counts the device calls made by the sensor models, so each sensor reads every field exactly once per update and the
+// device overhead of a frame stays bounded as sensors are added. Updates without a budget mustn't read the clock
+// either.
+
+namespace {
+    using loco::test::distanceDevices;
+    using loco::test::gpsDevices;
+
+    constexpr uint8_t GPS_PORT = 10;
+
+    void resetCounts() {
+        for (auto &device: distanceDevices) {
+            device.distanceReads = device.objectSizeReads = device.confidenceReads = device.otherReads = 0;
+        }
+
+        for (auto &device: gpsDevices) {
+            device.installedReads = device.statusReads = device.errorReads = device.otherReads = 0;
+        }
+    }
+
+    /**
+     * Each field of a distance sensor is read once by acquire() and update(), and apply() doesn't touch the device
+     */
+    template<typename Sensor>
+    void distanceReads(Sensor &sensor, const uint8_t port) {
+        const auto &device = distanceDevices[port];
+
+        resetCounts();
+        const loco::SensorReading reading = sensor.acquire();
+
+        CHECK(device.distanceReads == 1);
+        CHECK(device.objectSizeReads == 1);
+        CHECK(device.confidenceReads == 1);
+        CHECK(device.otherReads == 0);
+
+        resetCounts();
+        sensor.apply(reading);
+
+        CHECK(device.reads() == 0);
+
+        resetCounts();
+        sensor.update();
+
+        CHECK(device.distanceReads == 1);
+        CHECK(device.objectSizeReads == 1);
+        CHECK(device.confidenceReads == 1);
+        CHECK(device.otherReads == 0);
+    }
+
+    void gpsReads() {
+        loco::GpsSensorModel sensor(0_deg, pros::Gps(GPS_PORT));
+        auto &device = gpsDevices[GPS_PORT];
+
+        // The position and orientation come from one combined read
+        resetCounts();
+        const loco::SensorReading reading = sensor.acquire();
+
+        CHECK(device.installedReads == 1);
+        CHECK(device.statusReads == 1);
+        CHECK(device.errorReads == 1);
+        CHECK(device.otherReads == 0);
+
+        resetCounts();
+        sensor.apply(reading);
+
+        CHECK(device.reads() == 0);
+
+        resetCounts();
+        sensor.update();
+
+        CHECK(device.installedReads == 1);
+        CHECK(device.statusReads == 1);
+        CHECK(device.errorReads == 1);
+        CHECK(device.otherReads == 0);
+
+        // An unplugged GPS is only asked whether it is installed
+        device.installed = false;
+
+        resetCounts();
+        sensor.update();
+
+        CHECK(device.installedReads == 1);
+        CHECK(device.reads() == 1);
+
+        device.installed = true;
+    }
+
+    /**
+     * Total calls to every mocked device
+     */
+    size_t totalReads() {
+        size_t total = 0;
+
+        for (const auto &device: distanceDevices) {
+            total += device.reads();
+        }
+
+        for (const auto &device: gpsDevices) {
+            total += device.reads();
+        }
+
+        return total;
+    }
+
+    void frameReads() {
+        loco::ParticleFilter<100> filter([]() { return Angle(0.0); });
+
+        constexpr size_t DISTANCE_SENSORS = 6;
+
+        for (uint8_t port = 1; port <= DISTANCE_SENSORS; port++) {
+            filter.addSensor(new loco::DistanceSensorModel(Eigen::Vector3f(0.0f, 0.0f, port), pros::Distance(port)));
+        }
+
+        filter.addSensor(new loco::GpsSensorModel(0_deg, pros::Gps(GPS_PORT)));
+
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        const size_t expected = DISTANCE_SENSORS * 3 + 3;
+
+        // Enough movement that every frame runs the sensor update
+        for (size_t frame = 0; frame < 10; frame++) {
+            resetCounts();
+            filter.update([]() { return Eigen::Vector2f(0.05f, 0.0f); });
+
+            CHECK(totalReads() == expected);
+        }
+
+        std::printf("frame: %zu device reads with %zu distance sensors and a GPS\n", expected, DISTANCE_SENSORS);
+
+        // With the pipeline, the acquisition reads every device once and the update reads none
+        loco::LocalizationPipeline<8> pipeline([]() { return QLength(0.0); }, []() { return Angle(0.0); });
+        loco::DifferentialDriveMotionModel model(0.1f, 1_deg);
+
+        resetCounts();
+        pipeline.acquire(filter);
+
+        CHECK(totalReads() == expected);
+
+        resetCounts();
+        CHECK(pipeline.process(filter, model));
+        CHECK(totalReads() == 0);
+    }
+
+    /**
+     * Without a budget or a profiler, an update only reads the clock to timestamp its estimate
+     */
+    void clockReads() {
+        loco::ParticleFilter<100> filter([]() { return Angle(0.0); });
+
+        for (uint8_t port = 1; port <= 4; port++) {
+            filter.addSensor(new loco::DistanceSensorModel(Eigen::Vector3f(0.0f, 0.0f, port), pros::Distance(port)));
+        }
+
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        for (size_t frame = 0; frame < 10; frame++) {
+            distanceDevices[1].distance = 800 + static_cast<std::int32_t>(frame);
+
+            loco::test::clockReads = 0;
+            filter.update([]() { return Eigen::Vector2f(0.05f, 0.0f); });
+
+            CHECK(loco::test::clockReads <= 1);
+        }
+
+        // An update with a budget times every sensor
+        loco::test::clockReads = 0;
+        distanceDevices[1].distance = 700;
+        filter.update([]() { return Eigen::Vector2f(0.05f, 0.0f); }, 10_ms);
+
+        std::printf("clock: %zu reads in an update with a budget\n", loco::test::clockReads);
+
+        CHECK(loco::test::clockReads > 1);
+    }
+}
+
+int main() {
+    loco::DistanceSensorModel distance(Eigen::Vector3f::Zero(), pros::Distance(1));
+    distanceReads(distance, 1);
+
+    const loco::DistanceField field(loco::WALLS, 1.78308_m, 16);
+    loco::LikelihoodFieldSensorModel likelihood(Eigen::Vector3f::Zero(), pros::Distance(2), &field);
+    distanceReads(likelihood, 2);
+
+    gpsReads();
+    frameReads();
+    clockReads();
+
+    return failures;
+}
@@ -0,0 +1,163 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Checks the SIMD kernels of DistanceSensorModel against its scalar paths, and the scalar ray cast against a brute
+// force ray cast to the four walls.
+
+namespace {
+    constexpr uint8_t PORT = 1;
+
+    /**
+     * Distance from (x, y) along angle to the first wall of the square field, solved independently of WallTerms
+     */
+    float referenceRay(const float x, const float y, const float angle) {
+        const float dirX = std::cos(angle), dirY = std::sin(angle);
+
+        float nearest = 50.0f;
+
+        for (const auto &[a, b]: loco::WALLS) {
+            const Eigen::Vector2f edge = b - a;
+            const float denominator = dirX * edge.y() - dirY * edge.x();
+
+            if (std::abs(denominator) < 1e-9f) {
+                continue;
+            }
+
+            const float t = ((a.x() - x) * edge.y() - (a.y() - y) * edge.x()) / denominator;
+            const float s = ((a.x() - x) * dirY - (a.y() - y) * dirX) / denominator;
+
+            if (t >= 0.0f && s >= 0.0f && s <= 1.0f) {
+                nearest = std::min(nearest, t);
+            }
+        }
+
+        return nearest;
+    }
+
+    bool close(const float a, const float b, const float tolerance) {
+        return std::abs(a - b) <= tolerance * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+    }
+
+    void rayCast(std::mt19937 &random) {
+        std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-10.0f, 10.0f);
+
+        size_t mismatches = 0;
+
+        for (size_t i = 0; i < 100'000; i++) {
+            const float x = position(random), y = position(random), theta = angle(random);
+
+            mismatches += !close(loco::DistanceSensorModel::rayToWalls(x, y, theta), referenceRay(x, y, theta), 1e-4f);
+        }
+
+        std::printf("rayToWalls: %zu of 100000 rays differ from the reference\n", mismatches);
+
+        CHECK(mismatches == 0);
+    }
+
+    void sharedHeading(std::mt19937 &random) {
+        std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-M_PI, M_PI);
+        std::uniform_int_distribution<int32_t> reading(50, 2000);
+
+        size_t batchMismatches = 0, logMismatches = 0;
+
+        for (size_t trial = 0; trial < 500; trial++) {
+            const Eigen::Vector3f offset(position(random) * 0.1f, position(random) * 0.1f, angle(random));
+            loco::DistanceSensorModel sensor(offset, pros::Distance(PORT));
+
+            loco::test::distanceDevices[PORT].distance = reading(random);
+            sensor.update();
+
+            // Not a multiple of any packet size, so the scalar remainder runs too
+            const size_t count = 37 + trial % 8;
+            const float theta = angle(random);
+
+            std::vector<float> x(count), y(count), weights(count, 1.0f), logWeights(count, 0.0f);
+
+            for (size_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+            }
+
+            x[trial % count] = std::numeric_limits<float>::quiet_NaN();
+
+            sensor.pBatch(x, y, theta, weights);
+            sensor.logPBatch(x, y, theta, logWeights);
+
+            // The log table is interpolated separately, so the log kernel is checked against a batch of one particle,
+            // which is weighted entirely by the scalar path
+            for (size_t i = 0; i < count; i++) {
+                const auto scalar = static_cast<float>(sensor.p(Eigen::Vector3f(x[i], y[i], theta)).value());
+
+                float logScalar = 0.0f;
+                sensor.logPBatch({&x[i], 1}, {&y[i], 1}, theta, {&logScalar, 1});
+
+                batchMismatches += !close(weights[i], scalar, 1e-4f);
+                logMismatches += !close(logWeights[i], logScalar, 1e-4f);
+            }
+        }
+
+        std::printf("pBatch: %zu mismatches, logPBatch: %zu mismatches\n", batchMismatches, logMismatches);
+
+        CHECK(batchMismatches == 0);
+        CHECK(logMismatches == 0);
+    }
+
+    void perParticleHeading(std::mt19937 &random) {
+        std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-M_PI, M_PI);
+        std::uniform_int_distribution<int32_t> reading(50, 2000);
+
+        size_t mismatches = 0, logMismatches = 0;
+
+        for (size_t trial = 0; trial < 500; trial++) {
+            const Eigen::Vector3f offset(position(random) * 0.1f, position(random) * 0.1f, angle(random));
+            loco::DistanceSensorModel sensor(offset, pros::Distance(PORT));
+
+            loco::test::distanceDevices[PORT].distance = reading(random);
+            sensor.update();
+
+            const size_t count = 37 + trial % 8;
+
+            std::vector<float> x(count), y(count), theta(count), weights(count, 1.0f), logWeights(count, 0.0f);
+
+            for (size_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+                theta[i] = angle(random);
+            }
+
+            sensor.pBatchPose(x, y, theta, weights);
+            sensor.logPBatchPose(x, y, theta, logWeights);
+
+            // A batch of one particle is weighted entirely by the scalar path
+            for (size_t i = 0; i < count; i++) {
+                float scalar = 1.0f, logScalar = 0.0f;
+
+                sensor.pBatchPose({&x[i], 1}, {&y[i], 1}, {&theta[i], 1}, {&scalar, 1});
+                sensor.logPBatchPose({&x[i], 1}, {&y[i], 1}, {&theta[i], 1}, {&logScalar, 1});
+
+                mismatches += !close(weights[i], scalar, 1e-3f);
+                logMismatches += !close(logWeights[i], logScalar, 1e-3f);
+            }
+        }
+
+        std::printf("pBatchPose: %zu mismatches, logPBatchPose: %zu mismatches\n", mismatches, logMismatches);
+
+        CHECK(mismatches == 0);
+        CHECK(logMismatches == 0);
+    }
+}
+
+int main() {
+    std::mt19937 random(12);
+
+    rayCast(random);
+    sharedHeading(random);
+    perParticleHeading(random);
+
+    return failures;
+}
@@ -0,0 +1,101 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+// Checks how sensors without a sequence number tell new samples from old ones. A sensor reading the same value over
+// and over, like one on a robot standing still, has to be used again after LOCO_CONFIG::SENSOR_MAX_STALE_FRAMES.
+
+namespace {
+    constexpr size_t MAX_STALE = loco::LOCO_CONFIG::SENSOR_MAX_STALE_FRAMES;
+
+    void constantReading() {
+        loco::DistanceSensorModel sensor(Eigen::Vector3f::Zero(), pros::Distance(1));
+        loco::test::distanceDevices[1].distance = 900;
+
+        sensor.update();
+        CHECK(sensor.isFresh());
+
+        for (size_t cycle = 0; cycle < 3; cycle++) {
+            for (size_t frame = 0; frame < MAX_STALE; frame++) {
+                sensor.update();
+                CHECK(!sensor.isFresh());
+            }
+
+            sensor.update();
+            CHECK(sensor.isFresh());
+        }
+
+        // A changed reading is new straight away, and starts the count again
+        sensor.update();
+        CHECK(!sensor.isFresh());
+
+        loco::test::distanceDevices[1].distance = 901;
+        sensor.update();
+        CHECK(sensor.isFresh());
+
+        sensor.update();
+        CHECK(!sensor.isFresh());
+    }
+
+    void gps() {
+        loco::GpsSensorModel sensor(0_deg, pros::Gps(10));
+        auto &device = loco::test::gpsDevices[10];
+        device.x = 0.5;
+        device.y = -0.3;
+
+        sensor.update();
+        CHECK(sensor.isFresh());
+
+        for (size_t frame = 0; frame < MAX_STALE; frame++) {
+            sensor.update();
+            CHECK(!sensor.isFresh());
+        }
+
+        sensor.update();
+        CHECK(sensor.isFresh());
+
+        // An unplugged GPS never has a new sample
+        device.installed = false;
+
+        for (size_t frame = 0; frame < 2 * MAX_STALE + 2; frame++) {
+            sensor.update();
+            CHECK(!sensor.isFresh());
+        }
+
+        device.installed = true;
+    }
+
+    void filterKeepsCorrecting() {
+        loco::ParticleFilter<100> filter([]() { return Angle(0.0); });
+        filter.addSensor(new loco::DistanceSensorModel(Eigen::Vector3f::Zero(), pros::Distance(2)));
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        loco::test::distanceDevices[2].distance = 1000;
+
+        const uint32_t before = filter.getSnapshot().sequence;
+
+        constexpr size_t FRAMES = 60;
+
+        // Driving parallel to the wall, the reading never changes
+        for (size_t frame = 0; frame < FRAMES; frame++) {
+            filter.update([]() { return Eigen::Vector2f(0.0f, 0.05f); });
+        }
+
+        const uint32_t corrections = filter.getSnapshot().sequence - before;
+        const auto &freshness = filter.getSensors().getFreshness(0);
+
+        std::printf("constant reading: %u corrections in %zu frames, %zu fresh, %zu stale\n", corrections, FRAMES,
+                    freshness.fresh, freshness.stale);
+
+        CHECK(corrections >= FRAMES / (MAX_STALE + 1));
+        CHECK(freshness.fresh >= FRAMES / (MAX_STALE + 1));
+    }
+}
+
+int main() {
+    constantReading();
+    gps();
+    filterKeepsCorrecting();
+
+    return failures;
+}
@@ -0,0 +1,139 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Checks the weights of GpsSensorModel: they peak at the measured point, fall off with the Mahalanobis distance from
+// it, and the SIMD kernel matches the scalar path. A GPS reporting a large error mustn't touch the weights.
+
+namespace {
+    constexpr uint8_t PORT = 10;
+
+    bool close(const float a, const float b, const float tolerance) {
+        return std::abs(a - b) <= tolerance * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+    }
+
+    /**
+     * GPS model reading the mocked device once, at (x, y) in the GPS coordinate system
+     */
+    loco::GpsSensorModel reading(const double x, const double y, const double error) {
+        auto &device = loco::test::gpsDevices[PORT];
+        device = {};
+        device.x = x;
+        device.y = y;
+        device.error = error;
+
+        loco::GpsSensorModel sensor(0_deg, pros::Gps(PORT));
+        sensor.update();
+
+        return sensor;
+    }
+
+    void peak() {
+        loco::GpsSensorModel sensor = reading(0.4, -0.7, 0.005);
+
+        // The GPS x axis is the loco y axis, and the GPS y axis the negative loco x axis
+        const Eigen::Vector2f point(0.7f, 0.4f);
+        const float std = 0.005f * loco::LOCO_CONFIG::GPS_ERROR_SCALE;
+
+        const auto at = [&](const Eigen::Vector2f &position) {
+            return static_cast<float>(sensor.p(Eigen::Vector3f(position.x(), position.y(), 0.0f)).value());
+        };
+
+        const float top = at(point);
+
+        CHECK(close(top, loco::cheap_norm_pdf_squared(0.0f) * loco::LOCO_CONFIG::GPS_WEIGHT, 1e-6f));
+
+        size_t notFalling = 0, anisotropic = 0;
+
+        // Along every direction the weight falls with the distance, and is the same at the same number of standard
+        // deviations in any direction
+        for (size_t k = 0; k < 16; k++) {
+            const float angle = static_cast<float>(k) * static_cast<float>(M_PI) / 8.0f;
+            const Eigen::Vector2f direction(std::cos(angle), std::sin(angle));
+
+            float previous = top;
+
+            for (const float deviations: {0.25f, 0.5f, 1.0f, 2.0f, 4.0f}) {
+                const float weight = at(point + direction * deviations * std);
+                const float expected = loco::cheap_norm_pdf_squared(deviations * deviations) *
+                                       loco::LOCO_CONFIG::GPS_WEIGHT;
+
+                notFalling += weight >= previous;
+                anisotropic += !close(weight, expected, 1e-4f);
+                previous = weight;
+            }
+        }
+
+        std::printf("GPS peak: %zu weights not falling, %zu off the Mahalanobis distance\n", notFalling, anisotropic);
+
+        CHECK(notFalling == 0);
+        CHECK(anisotropic == 0);
+    }
+
+    void batch(std::mt19937 &random) {
+        std::uniform_real_distribution<float> position(-1.7f, 1.7f), error(0.0f, 0.015f);
+
+        size_t mismatches = 0, poseMismatches = 0;
+
+        for (size_t trial = 0; trial < 500; trial++) {
+            loco::GpsSensorModel sensor = reading(position(random), position(random), error(random));
+
+            // Not a multiple of any packet size, so the scalar remainder runs too
+            const size_t count = 37 + trial % 8;
+
+            std::vector<float> x(count), y(count), theta(count, 0.0f), weights(count, 1.0f), poseWeights(count, 1.0f);
+
+            for (size_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+            }
+
+            sensor.pBatch(x, y, 0.0f, weights);
+            sensor.pBatchPose(x, y, theta, poseWeights);
+
+            for (size_t i = 0; i < count; i++) {
+                const auto scalar = static_cast<float>(sensor.p(Eigen::Vector3f(x[i], y[i], 0.0f)).value());
+
+                mismatches += !close(weights[i], scalar, 1e-4f);
+                poseMismatches += !close(poseWeights[i], scalar, 1e-4f);
+            }
+        }
+
+        std::printf("GPS pBatch: %zu mismatches, pBatchPose: %zu mismatches\n", mismatches, poseMismatches);
+
+        CHECK(mismatches == 0);
+        CHECK(poseMismatches == 0);
+    }
+
+    void largeError() {
+        loco::GpsSensorModel sensor = reading(0.4, -0.7, 0.02);
+
+        std::vector<float> x = {0.7f, 0.0f, -1.0f, 0.5f, 1.2f}, y = {0.4f, 0.0f, 1.0f, 0.5f, -0.3f};
+        std::vector<float> theta(x.size(), 0.0f), weights(x.size(), 0.5f), poseWeights(x.size(), 0.5f);
+
+        sensor.pBatch(x, y, 0.0f, weights);
+        sensor.pBatchPose(x, y, theta, poseWeights);
+
+        CHECK(!sensor.p(Eigen::Vector3f(0.7f, 0.4f, 0.0f)).has_value());
+        CHECK(!sensor.isFresh());
+
+        for (size_t i = 0; i < x.size(); i++) {
+            CHECK(weights[i] == 0.5f);
+            CHECK(poseWeights[i] == 0.5f);
+        }
+    }
+}
+
+int main() {
+    std::mt19937 random(3);
+
+    peak();
+    batch(random);
+    largeError();
+
+    return failures;
+}
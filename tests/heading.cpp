@@ -0,0 +1,69 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+// Checks that HeadingEstimator follows the GPS yaw while the robot turns. The IMU starts off by a fixed angle, so the
+// estimate is only right once the GPS has corrected it. The particle filter updates the GPS after sampling the
+// heading, so a yaw fused against the wrong frame's heading leaves the estimate a frame's rotation behind the truth.
+// The GPS yaw is wrapped to a single turn while the heading is continuous, so turning several times must not make the
+// estimate jump by a turn.
+
+namespace {
+    constexpr double IMU_OFFSET = 0.3;
+    constexpr size_t SETTLE_FRAMES = 200;
+
+    /**
+     * Turn at a constant rate for several turns, and return the largest error of the heading once it has settled
+     *
+     * @param ratePerFrame Rotation of the robot every frame in radians
+     */
+    double turn(const double ratePerFrame) {
+        auto &device = loco::test::gpsDevices[10];
+        device = {};
+
+        double truth = 0.0;
+
+        loco::GpsSensorModel gps(0_deg, pros::Gps(10));
+        loco::HeadingEstimator heading([&truth]() { return Angle(static_cast<float>(truth + IMU_OFFSET)); }, &gps);
+
+        loco::ParticleFilter<100> filter(heading);
+        filter.addSensor(&gps);
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        const auto frames = static_cast<size_t>(3.0 * 2.0 * M_PI / std::abs(ratePerFrame));
+        double maxError = 0.0;
+
+        for (size_t frame = 0; frame < frames; frame++) {
+            truth += ratePerFrame;
+
+            // The GPS yaw is in degrees, clockwise and wrapped to [-180, 180)
+            device.yaw = -std::remainder(truth, 2.0 * M_PI) * 180.0 / M_PI;
+
+            const float step = frame % 2 == 0 ? 0.03f : -0.03f;
+            filter.update([step]() { return Eigen::Vector2f(step, 0.0f); });
+
+            if (frame >= SETTLE_FRAMES) {
+                // Unwrapped, a jump by a turn shows up as an error of 2 pi
+                maxError = std::max(maxError, std::abs(heading.getAngle().getValue() - truth));
+            }
+        }
+
+        return maxError;
+    }
+
+    void convergence() {
+        for (const double rate: {0.0, 0.01, -0.01, 0.05}) {
+            const double error = turn(rate);
+
+            std::printf("turning %.2f rad per frame: %.5f rad largest error\n", rate, error);
+
+            CHECK(error < 0.002);
+        }
+    }
+}
+
+int main() {
+    convergence();
+
+    return failures;
+}
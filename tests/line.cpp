@@ -0,0 +1,133 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Checks LineMap and LineMapSensorModel: the rasterized tape covers points on its center line and nothing a few
+// centimetres away, for tape in any direction, and the weights stay between LINE_MIN_LIKELIHOOD * LINE_WEIGHT and
+// LINE_WEIGHT for any reading. The batch kernels have to match the scalar path.
+
+namespace {
+    constexpr uint8_t PORT = 1;
+
+    bool close(const float a, const float b, const float tolerance) {
+        return std::abs(a - b) <= tolerance * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+    }
+
+    /**
+     * Check the coverage along a single piece of tape, and beside it
+     */
+    void coverageAlong(const Eigen::Vector2f &start, const Eigen::Vector2f &end, const char *name) {
+        const loco::LineMap map({{start, end}});
+
+        const Eigen::Vector2f direction = (end - start).normalized();
+        const Eigen::Vector2f normal(-direction.y(), direction.x());
+
+        float minOn = 1.0f, maxOff = 0.0f;
+
+        // Away from the ends, where the tape is rounded off
+        for (size_t k = 1; k < 100; k++) {
+            const Eigen::Vector2f point = start + (end - start) * (static_cast<float>(k) / 100.0f);
+
+            minOn = std::min(minOn, map.coverageAt(point.x(), point.y()));
+
+            for (const float side: {-1.0f, 1.0f}) {
+                const Eigen::Vector2f beside = point + normal * side * 0.06f;
+
+                maxOff = std::max(maxOff, map.coverageAt(beside.x(), beside.y()));
+            }
+        }
+
+        std::printf("%s tape: coverage at least %.3f on it, at most %.3f 6cm beside it\n", name, minOn, maxOff);
+
+        CHECK(minOn > 0.9f);
+        CHECK(maxOff < 0.05f);
+    }
+
+    void coverage() {
+        coverageAlong({0.5f, -1.0f}, {0.5f, 1.0f}, "vertical");
+        coverageAlong({-1.0f, -1.2f}, {0.8f, 0.6f}, "diagonal");
+
+        // Outside the field there is no tape
+        const loco::LineMap map;
+
+        CHECK(map.coverageAt(0.0f, 0.0f) > 0.9f);
+        CHECK(map.coverageAt(2.0f, 0.0f) == 0.0f);
+    }
+
+    void weights(std::mt19937 &random) {
+        std::uniform_real_distribution<float> position(-1.7f, 1.7f), angle(-M_PI, M_PI), offset(-0.2f, 0.2f);
+        std::uniform_int_distribution<int32_t> reading(0, 4095);
+
+        const loco::LineMap map;
+
+        const float low = loco::LOCO_CONFIG::LINE_MIN_LIKELIHOOD * loco::LOCO_CONFIG::LINE_WEIGHT;
+        const float high = loco::LOCO_CONFIG::LINE_WEIGHT;
+
+        size_t outOfRange = 0, batchMismatches = 0, poseMismatches = 0;
+        float lowest = high, highest = low;
+
+        for (size_t trial = 0; trial < 500; trial++) {
+            loco::LineMapSensorModel sensor(Eigen::Vector2f(offset(random), offset(random)), pros::adi::LineSensor(PORT),
+                                            &map);
+
+            // Clear readings on and off the tape as well as uncertain ones
+            loco::test::analogValues[PORT] = trial % 3 == 0 ? 0 : trial % 3 == 1 ? 4095 : reading(random);
+            sensor.update();
+
+            // Not a multiple of any packet size
+            const size_t count = 37 + trial % 8;
+            const float theta = angle(random);
+
+            std::vector<float> x(count), y(count), thetas(count), batch(count, 1.0f), pose(count, 1.0f);
+
+            for (size_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+                thetas[i] = angle(random);
+            }
+
+            // Half the particles sit on the middle line, so the weights cover both ends of the range
+            for (size_t i = 0; i < count; i += 2) {
+                y[i] = 0.0f;
+            }
+
+            sensor.prepare(theta);
+            sensor.pBatch(x, y, theta, batch);
+            sensor.pBatchPose(x, y, thetas, pose);
+
+            for (size_t i = 0; i < count; i++) {
+                const auto scalar = static_cast<float>(sensor.p(Eigen::Vector3f(x[i], y[i], theta)).value());
+                const auto poseScalar = static_cast<float>(sensor.p(Eigen::Vector3f(x[i], y[i], thetas[i])).value());
+
+                outOfRange += scalar < low - 1e-6f || scalar > high + 1e-6f;
+                lowest = std::min(lowest, scalar);
+                highest = std::max(highest, scalar);
+
+                batchMismatches += !close(batch[i], scalar, 1e-5f);
+                poseMismatches += !close(pose[i], poseScalar, 1e-4f);
+            }
+        }
+
+        std::printf("line weights: from %.3f to %.3f, %zu out of range, pBatch: %zu mismatches, pBatchPose: %zu "
+                    "mismatches\n", lowest, highest, outOfRange, batchMismatches, poseMismatches);
+
+        CHECK(outOfRange == 0);
+        CHECK(lowest < low + 0.05f);
+        CHECK(highest > high - 0.05f);
+        CHECK(batchMismatches == 0);
+        CHECK(poseMismatches == 0);
+    }
+}
+
+int main() {
+    std::mt19937 random(4);
+
+    coverage();
+    weights(random);
+
+    return failures;
+}
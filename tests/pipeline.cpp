@@ -0,0 +1,68 @@
+#include "main.h"
+#include "check.h"
+#include "localization/pipeline.h"
+
+#include <atomic>
+#include <thread>
+
+// Stress test of SpscRing: a producer and a consumer run as fast as they can while an observer polls size(), which
+// must never report more values than the ring holds. The values are a counter, so the consumer sees a lost or repeated
+// value as a gap in it.
+
+namespace {
+    constexpr uint32_t VALUES = 500'000;
+    constexpr size_t CAPACITY = 8;
+
+    void ringStress() {
+        loco::SpscRing<uint32_t, CAPACITY> ring;
+
+        std::atomic<bool> done{false};
+        std::atomic<size_t> oversized{0};
+        size_t outOfOrder = 0;
+
+        std::thread observer([&]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                oversized += ring.size() > CAPACITY;
+                std::this_thread::yield();
+            }
+        });
+
+        std::thread consumer([&]() {
+            uint32_t expected = 0;
+            uint32_t value;
+
+            while (expected < VALUES) {
+                if (ring.pop(value)) {
+                    outOfOrder += value != expected;
+                    expected = value + 1;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        for (uint32_t i = 0; i < VALUES;) {
+            if (ring.push(i)) {
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        consumer.join();
+        done = true;
+        observer.join();
+
+        std::printf("ring: %zu oversized sizes, %zu values out of order\n", oversized.load(), outOfOrder);
+
+        CHECK(oversized == 0);
+        CHECK(outOfOrder == 0);
+        CHECK(ring.size() == 0);
+    }
+}
+
+int main() {
+    ringStress();
+
+    return failures;
+}
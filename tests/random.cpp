@@ -0,0 +1,63 @@
+#include "main.h"
+#include "check.h"
+
+#include <vector>
+
+// Checks that engines created without a seed draw independent streams, while an explicit seed still replays the same
+// stream.
+
+namespace {
+    constexpr size_t DRAWS = 100'000;
+
+    std::vector<float> draw(loco::Xoshiro128Plus &random) {
+        std::vector<float> values(DRAWS);
+        random.fill(values, -1.0f, 1.0f);
+
+        return values;
+    }
+
+    double correlation(const std::vector<float> &a, const std::vector<float> &b) {
+        double ab = 0.0, aa = 0.0, bb = 0.0;
+
+        for (size_t i = 0; i < a.size(); i++) {
+            ab += a[i] * b[i];
+            aa += a[i] * a[i];
+            bb += b[i] * b[i];
+        }
+
+        return ab / std::sqrt(aa * bb);
+    }
+
+    void unseeded() {
+        loco::Xoshiro128Plus first, second;
+
+        const std::vector<float> a = draw(first);
+        const std::vector<float> b = draw(second);
+
+        size_t equal = 0;
+
+        for (size_t i = 0; i < DRAWS; i++) {
+            equal += a[i] == b[i];
+        }
+
+        const double r = correlation(a, b);
+
+        std::printf("unseeded: %zu equal draws, correlation %.4f\n", equal, r);
+
+        CHECK(equal < DRAWS / 1000);
+        CHECK(std::abs(r) < 0.02);
+    }
+
+    void seeded() {
+        loco::Xoshiro128Plus first(1234), second(1234);
+
+        CHECK(draw(first) == draw(second));
+    }
+}
+
+int main() {
+    unseeded();
+    seeded();
+
+    return failures;
+}
@@ -0,0 +1,227 @@
+#include "main.h"
+#include "check.h"
+#include "stubs/mockDevices.h"
+
+// Checks the kidnapping detection of the adaptive particle count. The average weight of a frame is the product of the
+// likelihoods of the sensors that scored it, so a frame that scores a different set of sensors has a different scale
+// and mustn't be mistaken for the filter being lost. That includes real sensors that sit out a new sample, like a distance
+// sensor blocked by a passing robot. A sensor returning NaN has to be reported, not spread through the weights.
+
+namespace {
+    /**
+     * Sensor that agrees with a robot at the origin, with its likelihood scaled so sensors don't share a scale
+     */
+    class ScaledSensor : public loco::SensorModel {
+        double scale;
+
+    public:
+        bool fresh = true;
+
+        explicit ScaledSensor(const double scale) : scale(scale) {
+        }
+
+        std::optional<double> p(const Eigen::Vector3f &X) override {
+            return scale * std::exp(-0.5 * X.head<2>().squaredNorm() / (0.1 * 0.1));
+        }
+
+        void update() override {
+        }
+
+        [[nodiscard]] bool isFresh() const override {
+            return fresh;
+        }
+    };
+
+    /**
+     * Number of particles too far from the origin to have survived resampling, so they must have been injected
+     */
+    size_t strayParticles(loco::ParticleFilter<500> &filter) {
+        size_t stray = 0;
+
+        for (const Eigen::Vector3f &particle: filter.getParticles()) {
+            stray += particle.head<2>().norm() > 0.6f;
+        }
+
+        return stray;
+    }
+
+    void changingSensorSet() {
+        ScaledSensor always(1.0), sometimes(1e-3);
+
+        loco::ParticleFilter<500> filter([]() { return Angle(0.0); });
+        filter.addSensor(&always);
+        filter.addSensor(&sometimes);
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+        filter.setAdaptiveParticleCount(true);
+
+        constexpr size_t FRAMES = 400;
+        size_t injections = 0;
+
+        for (size_t frame = 0; frame < FRAMES; frame++) {
+            // The second sensor drops out for stretches, like a GPS that can't see the field strip
+            sometimes.fresh = frame / 20 % 2 == 0;
+
+            // Back and forth around the origin, far enough that every frame corrects
+            const float step = frame % 2 == 0 ? 0.05f : -0.05f;
+            filter.update([step]() { return Eigen::Vector2f(step, 0.0f); });
+
+            injections += strayParticles(filter) > 0;
+        }
+
+        std::printf("changing sensor set: random particles injected in %zu of %zu frames\n", injections, FRAMES);
+
+        CHECK(injections == 0);
+    }
+
+    /**
+     * Run a filter at the origin with four distance sensors facing the walls, and count the frames with random
+     * particles in them. The readings change a little every frame so each one is a new sample.
+     *
+     * @param gps Whether to add a GPS as well
+     * @param setup Called before every frame with the frame number, to change the mocked devices
+     */
+    template<typename Setup>
+    size_t strayFrames(const size_t frames, const bool gps, Setup &&setup) {
+        for (uint8_t port = 1; port <= 4; port++) {
+            loco::test::distanceDevices[port] = {};
+        }
+
+        loco::test::gpsDevices[10] = {};
+
+        loco::ParticleFilter<500> filter([]() { return Angle(0.0); });
+
+        for (uint8_t port = 1; port <= 4; port++) {
+            const Eigen::Vector3f offset(0.0f, 0.0f, static_cast<float>((port - 1) * M_PI_2));
+            filter.addSensor(new loco::DistanceSensorModel(offset, pros::Distance(port)));
+        }
+
+        if (gps) {
+            filter.addSensor(new loco::GpsSensorModel(0_deg, pros::Gps(10)));
+        }
+
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+        filter.setAdaptiveParticleCount(true);
+
+        size_t stray = 0;
+
+        for (size_t frame = 0; frame < frames; frame++) {
+            for (uint8_t port = 1; port <= 4; port++) {
+                loco::test::distanceDevices[port].distance = 1783 + static_cast<std::int32_t>(frame % 3);
+            }
+
+            loco::test::gpsDevices[10].x = 0.001 * static_cast<double>(frame % 3);
+
+            setup(frame);
+
+            const float step = frame % 2 == 0 ? 0.03f : -0.03f;
+            filter.update([step]() { return Eigen::Vector2f(step, 0.0f); });
+
+            stray += strayParticles(filter) > 0;
+        }
+
+        return stray;
+    }
+
+    void blockedDistanceSensor() {
+        // Another robot in front of sensor 2 for 100 frames, small objects aren't scored
+        const size_t stray = strayFrames(600, false, [](const size_t frame) {
+            loco::test::distanceDevices[2].objectSize = frame >= 200 && frame < 300 ? 40 : 200;
+        });
+
+        std::printf("blocked distance sensor: random particles in %zu of 600 frames\n", stray);
+
+        CHECK(stray == 0);
+    }
+
+    void gpsErrorClears() {
+        // Samples with a large error aren't scored until the GPS settles
+        const size_t stray = strayFrames(600, true, [](const size_t frame) {
+            loco::test::gpsDevices[10].error = frame < 200 ? 0.02 : 0.005;
+        });
+
+        std::printf("GPS error clears: random particles in %zu of 600 frames\n", stray);
+
+        CHECK(stray == 0);
+    }
+
+    void kidnapped() {
+        ScaledSensor sensor(1.0);
+
+        loco::ParticleFilter<500> filter([]() { return Angle(0.0); });
+        filter.addSensor(&sensor);
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+        filter.setAdaptiveParticleCount(true);
+
+        for (size_t frame = 0; frame < 100; frame++) {
+            const float step = frame % 2 == 0 ? 0.05f : -0.05f;
+            filter.update([step]() { return Eigen::Vector2f(step, 0.0f); });
+        }
+
+        CHECK(strayParticles(filter) == 0);
+
+        // Carried off a meter, the sensors still see the origin
+        filter.update([]() { return Eigen::Vector2f(1.0f, 0.0f); });
+
+        // Without random particles near the origin, resampling can't bring the belief back
+        size_t frames = 0;
+
+        while (frames < 50 && filter.getPrediction().head<2>().norm() > 0.3f) {
+            const float step = frames % 2 == 0 ? 0.05f : -0.05f;
+            filter.update([step]() { return Eigen::Vector2f(step, 0.0f); });
+            frames++;
+        }
+
+        std::printf("kidnapped: recovered after %zu frames\n", frames);
+
+        CHECK(frames < 50);
+    }
+
+    /**
+     * Sensor with a batch kernel that returns NaN for every particle, the default batch kernel skips invalid values
+     */
+    class BrokenSensor : public loco::SensorModel {
+    public:
+        std::optional<double> p(const Eigen::Vector3f &X) override {
+            return std::nullopt;
+        }
+
+        void logPBatch(std::span<const float> x, std::span<const float> y, const float theta,
+                       std::span<float> logWeights) override {
+            std::fill(logWeights.begin(), logWeights.end(), std::numeric_limits<float>::quiet_NaN());
+        }
+
+        void update() override {
+        }
+    };
+
+    void invalidReading() {
+        ScaledSensor sensor(1.0);
+        BrokenSensor broken;
+
+        loco::ParticleFilter<100> filter([]() { return Angle(0.0); });
+        filter.addSensor(&sensor);
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        const loco::DeadlineReport valid = filter.update([]() { return Eigen::Vector2f(0.05f, 0.0f); }, 100_ms);
+
+        CHECK(valid.corrected);
+        CHECK(!valid.weightsInvalid);
+
+        filter.addSensor(&broken);
+
+        const loco::DeadlineReport invalid = filter.update([]() { return Eigen::Vector2f(-0.05f, 0.0f); }, 100_ms);
+
+        CHECK(invalid.weightsInvalid);
+        CHECK(filter.getPrediction().allFinite());
+    }
+}
+
+int main() {
+    changingSensorSet();
+    blockedDistanceSensor();
+    gpsErrorClears();
+    kidnapped();
+    invalidReading();
+
+    return failures;
+}
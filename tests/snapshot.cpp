@@ -0,0 +1,150 @@
+#include "main.h"
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Stress test of DoubleBufferedSlot: a single writer publishes snapshots as fast as it can while several readers load
+// them. Every field of a published snapshot is derived from its sequence number, so a torn read shows up as a field
+// that doesn't match the others.
+
+namespace {
+    constexpr uint32_t WRITES = 2'000'000;
+    constexpr size_t READERS = 4;
+
+    loco::PoseSnapshot makeSnapshot(const uint32_t sequence) {
+        loco::PoseSnapshot snapshot;
+        snapshot.sequence = sequence;
+        snapshot.timestamp = static_cast<uint64_t>(sequence) * 1000;
+
+        for (size_t i = 0; i < snapshot.pose.size(); i++) {
+            snapshot.pose[i] = static_cast<float>(sequence % 100'000) + static_cast<float>(i);
+        }
+
+        for (size_t i = 0; i < snapshot.covariance.size(); i++) {
+            snapshot.covariance[i] = static_cast<float>(sequence % 100'000) * 0.5f + static_cast<float>(i);
+        }
+
+        return snapshot;
+    }
+
+    bool consistent(const loco::PoseSnapshot &snapshot) {
+        const loco::PoseSnapshot expected = makeSnapshot(snapshot.sequence);
+
+        return snapshot.timestamp == expected.timestamp && snapshot.pose == expected.pose &&
+               snapshot.covariance == expected.covariance;
+    }
+
+    void slotStress() {
+        loco::DoubleBufferedSlot<loco::PoseSnapshot> slot;
+        slot.store(makeSnapshot(0));
+
+        std::atomic<bool> done{false};
+        std::atomic<size_t> torn{0}, backwards{0}, reads{0};
+
+        std::vector<std::thread> readers;
+
+        for (size_t r = 0; r < READERS; r++) {
+            readers.emplace_back([&]() {
+                uint32_t last = 0;
+                size_t count = 0;
+
+                while (!done.load(std::memory_order_relaxed)) {
+                    const loco::PoseSnapshot snapshot = slot.load();
+
+                    torn += !consistent(snapshot);
+                    backwards += snapshot.sequence < last;
+
+                    last = snapshot.sequence;
+                    count++;
+                }
+
+                reads += count;
+            });
+        }
+
+        for (uint32_t sequence = 1; sequence <= WRITES; sequence++) {
+            slot.store(makeSnapshot(sequence));
+        }
+
+        done = true;
+
+        for (auto &reader: readers) {
+            reader.join();
+        }
+
+        std::printf("slot: %u writes, %zu reads, %zu torn, %zu out of order\n", WRITES, reads.load(), torn.load(),
+                    backwards.load());
+
+        CHECK(torn == 0);
+        CHECK(backwards == 0);
+        CHECK(slot.load().sequence == WRITES);
+    }
+
+    /**
+     * Sensor that scores every particle the same, so the filter's updates only cost the motion and resampling
+     */
+    class FlatSensor : public loco::SensorModel {
+    public:
+        std::optional<double> p(const Eigen::Vector3f &X) override {
+            return 1.0;
+        }
+
+        void update() override {
+        }
+    };
+
+    void filterStress() {
+        FlatSensor sensor;
+        loco::ParticleFilter<200> filter([]() { return Angle(0.0); });
+        filter.addSensor(&sensor);
+        filter.initNormal({0.0f, 0.0f}, Eigen::Matrix2f::Identity() * 0.01f, false);
+
+        constexpr uint32_t UPDATES = 20'000;
+
+        std::atomic<bool> done{false};
+        std::atomic<size_t> invalid{0}, backwards{0};
+
+        std::vector<std::thread> readers;
+
+        for (size_t r = 0; r < READERS; r++) {
+            readers.emplace_back([&]() {
+                uint32_t last = 0;
+
+                while (!done.load(std::memory_order_relaxed)) {
+                    const loco::PoseSnapshot snapshot = filter.getSnapshot();
+
+                    invalid += !snapshot.getPose().allFinite() || !snapshot.getCovariance().allFinite();
+                    backwards += snapshot.sequence < last;
+
+                    last = snapshot.sequence;
+                }
+            });
+        }
+
+        for (uint32_t i = 0; i < UPDATES; i++) {
+            filter.update([]() { return Eigen::Vector2f(0.05f, 0.0f); });
+        }
+
+        done = true;
+
+        for (auto &reader: readers) {
+            reader.join();
+        }
+
+        std::printf("filter: %u updates, %zu invalid snapshots, %zu out of order\n", UPDATES, invalid.load(),
+                    backwards.load());
+
+        CHECK(invalid == 0);
+        CHECK(backwards == 0);
+        CHECK(filter.getSnapshot().sequence >= UPDATES);
+    }
+}
+
+int main() {
+    slotStress();
+    filterStress();
+
+    return failures;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace loco::test {
+    /**
+     * @brief State of a mocked distance sensor, returned by the pros::Distance stub on its port.
+     */
+    struct MockDistance {
+        std::int32_t distance = 800;
+        std::int32_t objectSize = 200;
+        std::int32_t confidence = 63;
+
+        /**
+         * Number of calls to each getter, a test resets them by assigning 0
+         */
+        size_t distanceReads = 0;
+        size_t objectSizeReads = 0;
+        size_t confidenceReads = 0;
+        size_t otherReads = 0;
+
+        [[nodiscard]] size_t reads() const {
+            return distanceReads + objectSizeReads + confidenceReads + otherReads;
+        }
+    };
+
+    /**
+     * @brief State of a mocked GPS, returned by the pros::Gps stub on its port.
+     */
+    struct MockGps {
+        bool installed = true;
+        double x = 0.0;
+        double y = 0.0;
+        double yaw = 0.0;
+        double error = 0.005;
+
+        /**
+         * Number of calls to each getter, a test resets them by assigning 0
+         */
+        size_t installedReads = 0;
+        size_t statusReads = 0;
+        size_t errorReads = 0;
+        size_t otherReads = 0;
+
+        [[nodiscard]] size_t reads() const {
+            return installedReads + statusReads + errorReads + otherReads;
+        }
+    };
+
+    /**
+     * Mocked devices on each smart port, indexed by port number
+     */
+    inline std::array<MockDistance, 22> distanceDevices{};
+    inline std::array<MockGps, 22> gpsDevices{};
+
+    /**
+     * Raw values of mocked analog sensors on each ADI port, indexed by port number from 1 to 8, or 'A' to 'H'
+     */
+    inline std::array<std::int32_t, 9> analogValues{};
+
+    /**
+     * Number of calls to pros::micros(), a test resets it by assigning 0
+     */
+    inline size_t clockReads = 0;
+}
@@ -0,0 +1,226 @@
+#include "main.h"
+#include "stubs/mockDevices.h"
+
+#include <chrono>
+
+// Host stand-ins for the parts of the PROS kernel used by the localization headers. Devices read from the mocks in
+// mockDevices.h, so a test sets what each device returns, and count their calls so a test can check how often each
+// device and the clock are read.
+
+namespace {
+    const auto start = std::chrono::steady_clock::now();
+}
+
+extern "C" {
+    uint32_t millis() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint64_t micros() {
+        loco::test::clockReads++;
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+namespace pros::v5 {
+    using loco::test::distanceDevices;
+    using loco::test::gpsDevices;
+
+    bool Device::is_installed() {
+        if (_deviceType == DeviceType::gps) {
+            gpsDevices[_port].installedReads++;
+            return gpsDevices[_port].installed;
+        }
+
+        distanceDevices[_port].otherReads++;
+        return true;
+    }
+
+    Distance::Distance(const std::uint8_t port) : Device(port, DeviceType::distance) {
+    }
+
+    std::int32_t Distance::get() {
+        distanceDevices[_port].distanceReads++;
+        return distanceDevices[_port].distance;
+    }
+
+    std::int32_t Distance::get_distance() {
+        distanceDevices[_port].distanceReads++;
+        return distanceDevices[_port].distance;
+    }
+
+    std::int32_t Distance::get_confidence() {
+        distanceDevices[_port].confidenceReads++;
+        return distanceDevices[_port].confidence;
+    }
+
+    std::int32_t Distance::get_object_size() {
+        distanceDevices[_port].objectSizeReads++;
+        return distanceDevices[_port].objectSize;
+    }
+
+    double Distance::get_object_velocity() {
+        distanceDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    std::int32_t Gps::initialize_full(double, double, double, double, double) const {
+        gpsDevices[_port].otherReads++;
+        return 1;
+    }
+
+    std::int32_t Gps::set_offset(double, double) const {
+        gpsDevices[_port].otherReads++;
+        return 1;
+    }
+
+    pros::gps_position_s_t Gps::get_offset() const {
+        gpsDevices[_port].otherReads++;
+        return {};
+    }
+
+    std::int32_t Gps::set_position(double, double, double) const {
+        gpsDevices[_port].otherReads++;
+        return 1;
+    }
+
+    std::int32_t Gps::set_data_rate(std::uint32_t) const {
+        gpsDevices[_port].otherReads++;
+        return 1;
+    }
+
+    double Gps::get_error() const {
+        gpsDevices[_port].errorReads++;
+        return gpsDevices[_port].error;
+    }
+
+    pros::gps_status_s_t Gps::get_position_and_orientation() const {
+        gpsDevices[_port].statusReads++;
+
+        pros::gps_status_s_t status{};
+        status.x = gpsDevices[_port].x;
+        status.y = gpsDevices[_port].y;
+        status.yaw = gpsDevices[_port].yaw;
+
+        return status;
+    }
+
+    pros::gps_position_s_t Gps::get_position() const {
+        gpsDevices[_port].otherReads++;
+        return {gpsDevices[_port].x, gpsDevices[_port].y};
+    }
+
+    double Gps::get_position_x() const {
+        gpsDevices[_port].otherReads++;
+        return gpsDevices[_port].x;
+    }
+
+    double Gps::get_position_y() const {
+        gpsDevices[_port].otherReads++;
+        return gpsDevices[_port].y;
+    }
+
+    pros::gps_orientation_s_t Gps::get_orientation() const {
+        gpsDevices[_port].otherReads++;
+        return {0.0, 0.0, gpsDevices[_port].yaw};
+    }
+
+    double Gps::get_pitch() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_roll() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_yaw() const {
+        gpsDevices[_port].otherReads++;
+        return gpsDevices[_port].yaw;
+    }
+
+    double Gps::get_heading() const {
+        gpsDevices[_port].otherReads++;
+        return gpsDevices[_port].yaw;
+    }
+
+    double Gps::get_heading_raw() const {
+        gpsDevices[_port].otherReads++;
+        return gpsDevices[_port].yaw;
+    }
+
+    pros::gps_gyro_s_t Gps::get_gyro_rate() const {
+        gpsDevices[_port].otherReads++;
+        return {};
+    }
+
+    double Gps::get_gyro_rate_x() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_gyro_rate_y() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_gyro_rate_z() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    pros::gps_accel_s_t Gps::get_accel() const {
+        gpsDevices[_port].otherReads++;
+        return {};
+    }
+
+    double Gps::get_accel_x() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_accel_y() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+
+    double Gps::get_accel_z() const {
+        gpsDevices[_port].otherReads++;
+        return 0.0;
+    }
+}
+
+namespace pros::adi {
+    namespace {
+        /**
+         * Index of an ADI port given as a number from 1 to 8 or a letter from 'A' to 'H'
+         */
+        std::uint8_t portIndex(const std::uint8_t port) {
+            if (port >= 'a' && port <= 'h') {
+                return port - 'a' + 1;
+            }
+
+            if (port >= 'A' && port <= 'H') {
+                return port - 'A' + 1;
+            }
+
+            return port;
+        }
+    }
+
+    Port::Port(const std::uint8_t adi_port, adi_port_config_e_t) : _smart_port(INTERNAL_ADI_PORT),
+                                                                   _adi_port(portIndex(adi_port)) {
+    }
+
+    ext_adi_port_tuple_t Port::get_port() const {
+        return {_smart_port, _adi_port, 0};
+    }
+
+    std::int32_t Port::get_value() const {
+        return loco::test::analogValues[_adi_port];
+    }
+
+    AnalogIn::AnalogIn(const std::uint8_t adi_port) : Port(adi_port, E_ADI_ANALOG_IN) {
+    }
+}